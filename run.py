@@ -87,71 +87,30 @@ for cpu in get_cpus():
 for gpu in get_gpus():
     report_append(gpu)
 
+# Every invocation loads its data set once and runs all configurations of its matrix
 report_append('')
-report_append('========= BC1 ==================================================================')
-run_benchmark('--input .content/large --format bc1 --codec compressonator --quality low')
-run_benchmark('--input .content/large --format bc1 --codec compressonator --quality medium')
-run_benchmark('--input .content/large --format bc1 --codec compressonator --quality high')
-run_benchmark('--input .content/large --format bc1 --codec nvtt --quality low')
-run_benchmark('--input .content/large --format bc1 --codec nvtt --quality medium')
-run_benchmark('--input .content/large --format bc1 --codec nvtt --quality high')
-run_benchmark('--input .content/large --format bc1 --codec nvtt --quality low --gpu')
-run_benchmark('--input .content/large --format bc1 --codec nvtt --quality medium --gpu')
-run_benchmark('--input .content/large --format bc1 --codec nvtt --quality high --gpu')
-run_benchmark('--input .content/large --format bc1 --codec directxtex')
+report_append('========= BC1 BC3 ==============================================================')
+run_benchmark('--input .content/large --format bc1 --codec compressonator nvtt directxtex --quality low medium high --gpu off on')
+run_benchmark('--input .content/large --format bc3 --codec compressonator nvtt directxtex --quality low medium high')
 
 report_append('')
-report_append('========= BC3 ==================================================================')
-run_benchmark('--input .content/large --format bc3 --codec compressonator --quality low')
-run_benchmark('--input .content/large --format bc3 --codec compressonator --quality medium')
-run_benchmark('--input .content/large --format bc3 --codec compressonator --quality high')
-run_benchmark('--input .content/large --format bc3 --codec nvtt --quality low')
-run_benchmark('--input .content/large --format bc3 --codec nvtt --quality medium')
-run_benchmark('--input .content/large --format bc3 --codec nvtt --quality high')
-run_benchmark('--input .content/large --format bc3 --codec directxtex')
-
-report_append('')
-report_append('========= BC4 ==================================================================')
-run_benchmark('--input .content/large --format bc4 --codec compressonator --quality low')
-run_benchmark('--input .content/large --format bc4 --codec compressonator --quality medium')
-run_benchmark('--input .content/large --format bc4 --codec compressonator --quality high')
-run_benchmark('--input .content/large --format bc4 --codec nvtt --quality low')
-run_benchmark('--input .content/large --format bc4 --codec nvtt --quality medium')
-run_benchmark('--input .content/small --format bc4 --codec nvtt --quality high')
-run_benchmark('--input .content/large --format bc4 --codec directxtex')
-
-report_append('')
-report_append('========= BC5 ==================================================================')
-run_benchmark('--input .content/large --format bc5 --codec compressonator --quality low')
-run_benchmark('--input .content/large --format bc5 --codec compressonator --quality medium')
-run_benchmark('--input .content/large --format bc5 --codec compressonator --quality high')
-run_benchmark('--input .content/large --format bc5 --codec nvtt --quality low')
-run_benchmark('--input .content/large --format bc5 --codec nvtt --quality medium')
-run_benchmark('--input .content/small --format bc5 --codec nvtt --quality high')
-run_benchmark('--input .content/large --format bc5 --codec directxtex')
+report_append('========= BC4 BC5 ==============================================================')
+run_benchmark('--input .content/large --format bc4 bc5 --codec compressonator directxtex --quality low medium high')
+run_benchmark('--input .content/large --format bc4 bc5 --codec nvtt --quality low medium')
+run_benchmark('--input .content/small --format bc4 bc5 --codec nvtt --quality high')
 
 report_append('')
 report_append('========= BC6 ==================================================================')
 run_benchmark('--input .content/large --format bc6 --codec compressonator --quality low')
-run_benchmark('--input .content/small --format bc6 --codec compressonator --quality medium')
-run_benchmark('--input .content/small --format bc6 --codec compressonator --quality high')
-run_benchmark('--input .content/large --format bc6 --codec nvtt --quality low')
-run_benchmark('--input .content/large --format bc6 --codec nvtt --quality medium')
-run_benchmark('--input .content/large --format bc6 --codec nvtt --quality high')
+run_benchmark('--input .content/small --format bc6 --codec compressonator --quality medium high')
+run_benchmark('--input .content/large --format bc6 --codec nvtt --quality low medium high')
 run_benchmark('--input .content/small --format bc6 --codec directxtex')
 run_benchmark('--input .content/large --format bc6 --codec directxtex --gpu')
 
 report_append('')
 report_append('========= BC7 ==================================================================')
-run_benchmark('--input .content/small --format bc7 --codec compressonator --quality low')
-run_benchmark('--input .content/small --format bc7 --codec compressonator --quality medium')
-run_benchmark('--input .content/small --format bc7 --codec compressonator --quality high')
-run_benchmark('--input .content/small --format bc7 --codec nvtt --quality low')
-run_benchmark('--input .content/small --format bc7 --codec nvtt --quality medium')
-run_benchmark('--input .content/small --format bc7 --codec nvtt --quality high')
+run_benchmark('--input .content/small --format bc7 --codec compressonator nvtt --quality low medium high')
+run_benchmark('--input .content/small --format bc7 --codec directxtex --bc7use3subsets off on')
 run_benchmark('--input .content/large --format bc7 --codec directxtex --bc7quick')
-run_benchmark('--input .content/small --format bc7 --codec directxtex')
-run_benchmark('--input .content/small --format bc7 --codec directxtex --bc7use3subsets')
-run_benchmark('--input .content/large --format bc7 --codec directxtex --gpu --bc7quick')
-run_benchmark('--input .content/large --format bc7 --codec directxtex --gpu')
+run_benchmark('--input .content/large --format bc7 --codec directxtex --gpu --bc7quick off on')
 run_benchmark('--input .content/large --format bc7 --codec directxtex --gpu --bc7use3subsets')
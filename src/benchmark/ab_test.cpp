@@ -0,0 +1,255 @@
+#include "ab_test.hpp"
+#include "error_calculator.hpp"
+#include "parallel.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+
+namespace
+{
+struct Side
+{
+	Configuration config;
+	std::unique_ptr<Codec> codec;
+	CompressedImage compressed;
+	// Per image, one entry per timed round
+	std::vector<std::vector<double>> nanoseconds;
+	std::vector<uint64_t> squaredErrors;
+	std::vector<char> failed;
+};
+
+Side makeSide(const Configuration& config, size_t imageCount)
+{
+	Side side;
+	side.config = config;
+	side.codec = makeCodec(config);
+	side.nanoseconds.resize(imageCount);
+	side.squaredErrors.resize(imageCount, 0);
+	side.failed.resize(imageCount, 0);
+	return side;
+}
+
+bool compressTimed(Side& side, const DataSetImage& entry, size_t index, bool measured, bool firstMeasured)
+{
+	TraceZone zone("compress", entry.name);
+	auto start = Clock::now();
+	auto succeeded = side.codec->compress(entry.image, side.config.format, side.compressed);
+	auto end = Clock::now();
+
+	// The error only depends on the codec output, one round is enough
+	if (succeeded && firstMeasured)
+	{
+		succeeded = computeBlockErrors(entry.image, side.compressed, relevantChannels(side.config.format), hardwareThreadCount(), side.squaredErrors[index]);
+	}
+
+	if (!succeeded)
+	{
+		std::cerr << "Failed to compress image " << entry.name << " with " << describe(side.config) << std::endl;
+		side.failed[index] = 1;
+		return false;
+	}
+
+	if (measured)
+	{
+		side.nanoseconds[index].push_back(static_cast<double>(elapsedNanoseconds(start, end)));
+	}
+
+	return true;
+}
+
+// Results over the images both sides compressed, a round over them counts as a pass
+Benchmark::Results makeSideResults(const DataSet& dataSet, const Side& side, const std::vector<size_t>& images, size_t roundCount)
+{
+	Benchmark::Results results;
+	results.hasErrors = images.size() < dataSet.size();
+	results.processedBytes = 0;
+	results.threadCount = 1;
+	results.codecThreadCount = side.codec->threadCount();
+	results.peakResidentBytes = 0;
+	results.perfCounterBlocks = 0;
+
+	std::vector<double> passNanoseconds(roundCount, 0.0);
+	uint64_t squaredErrorSum = 0;
+	uint64_t sampleCount = 0;
+	size_t processedBlocks = 0;
+	for (auto i : images)
+	{
+		const auto& image = dataSet[i].image;
+		auto blocks = ((image.width + 3) / 4) * ((image.height + 3) / 4);
+		results.processedBytes += image.bytes.size();
+		processedBlocks += blocks;
+		squaredErrorSum += side.squaredErrors[i];
+		sampleCount += static_cast<uint64_t>(image.width) * image.height * relevantChannels(side.config.format);
+
+		for (size_t round = 0; round < roundCount; ++round)
+		{
+			passNanoseconds[round] += side.nanoseconds[i][round];
+		}
+
+		Benchmark::ImageResults imageResults;
+		imageResults.name = dataSet[i].name;
+		imageResults.width = image.width;
+		imageResults.height = image.height;
+		imageResults.elapsedNanoseconds = computeStatistics(side.nanoseconds[i]);
+		imageResults.cyclesPerBlock = 0.0;
+		results.images.push_back(std::move(imageResults));
+	}
+
+	// The whole data set stays loaded, every call compresses into the same image
+	for (const auto& entry : dataSet)
+	{
+		results.peakResidentBytes += entry.image.bytes.size();
+	}
+	results.peakResidentBytes += side.compressed.bytes.capacity();
+
+	results.compressionError = sampleCount > 0 ? std::sqrt(static_cast<double>(squaredErrorSum) / sampleCount) / 255.0 : 0.0;
+	results.passNanoseconds = computeStatistics(passNanoseconds);
+	results.elapsedSeconds = results.passNanoseconds.median * 1e-9;
+	results.nanosecondsPerBlock = processedBlocks > 0 ? results.passNanoseconds.median / processedBlocks : 0.0;
+
+	auto throughput = results.elapsedSeconds > 0.0 ? results.processedBytes / results.elapsedSeconds : 0.0;
+	results.throughputBytesPerSec = static_cast<size_t>(throughput);
+
+	return results;
+}
+
+double median(std::vector<double> samples)
+{
+	return computeStatistics(std::move(samples)).median;
+}
+} // namespace
+
+AbTestResult runAbTest(
+	const DataSet& dataSet,
+	const Configuration& a,
+	const Configuration& b,
+	const AbTestSettings& settings,
+	const Benchmark::Settings& benchmarkSettings)
+{
+	auto sideA = makeSide(a, dataSet.size());
+	auto sideB = makeSide(b, dataSet.size());
+
+	auto roundCount = std::max<size_t>(benchmarkSettings.repetitions, 1);
+	for (size_t pass = 0, passCount = benchmarkSettings.warmupRuns + roundCount; pass < passCount; ++pass)
+	{
+		auto measured = pass >= benchmarkSettings.warmupRuns;
+		auto firstMeasured = pass == benchmarkSettings.warmupRuns;
+
+		for (size_t i = 0; i < dataSet.size(); ++i)
+		{
+			if (sideA.failed[i] || sideB.failed[i])
+			{
+				continue;
+			}
+
+			// Alternating the order cancels out whatever the first call leaves behind for the second one, e.g. in caches
+			auto first = (pass + i) % 2 == 0 ? &sideA : &sideB;
+			auto second = first == &sideA ? &sideB : &sideA;
+			if (compressTimed(*first, dataSet[i], i, measured, firstMeasured))
+			{
+				compressTimed(*second, dataSet[i], i, measured, firstMeasured);
+			}
+		}
+	}
+
+	// Only pairs count, an image either side failed on is left out of both
+	std::vector<size_t> images;
+	for (size_t i = 0; i < dataSet.size(); ++i)
+	{
+		if (!sideA.failed[i] && !sideB.failed[i])
+		{
+			images.push_back(i);
+		}
+	}
+
+	AbTestResult result;
+	result.a = { a, makeSideResults(dataSet, sideA, images, roundCount) };
+	result.b = { b, makeSideResults(dataSet, sideB, images, roundCount) };
+	if (images.empty())
+	{
+		return result;
+	}
+
+	double totalA = 0.0;
+	double totalB = 0.0;
+	for (auto i : images)
+	{
+		totalA += std::accumulate(std::begin(sideA.nanoseconds[i]), std::end(sideA.nanoseconds[i]), 0.0);
+		totalB += std::accumulate(std::begin(sideB.nanoseconds[i]), std::end(sideB.nanoseconds[i]), 0.0);
+		result.imageRatios.push_back(median(sideA.nanoseconds[i]) / median(sideB.nanoseconds[i]));
+	}
+	result.ratio = totalA / totalB;
+
+	// A round of an image is drawn as a pair, which keeps the pairing of back to back calls
+	std::mt19937_64 random(settings.seed);
+	std::vector<double> resampled;
+	resampled.reserve(settings.bootstrapResamples);
+	for (size_t resample = 0; resample < settings.bootstrapResamples; ++resample)
+	{
+		double sumA = 0.0;
+		double sumB = 0.0;
+		for (size_t draw = 0; draw < images.size(); ++draw)
+		{
+			auto i = images[random() % images.size()];
+			for (size_t round = 0; round < roundCount; ++round)
+			{
+				auto drawnRound = random() % roundCount;
+				sumA += sideA.nanoseconds[i][drawnRound];
+				sumB += sideB.nanoseconds[i][drawnRound];
+			}
+		}
+		resampled.push_back(sumA / sumB);
+	}
+
+	if (resampled.empty())
+	{
+		return result;
+	}
+
+	std::sort(std::begin(resampled), std::end(resampled));
+	auto tail = (1.0 - settings.confidence) / 2.0;
+	result.ratioLow = percentile(resampled, tail);
+	result.ratioHigh = percentile(resampled, 1.0 - tail);
+
+	auto below = std::count_if(std::begin(resampled), std::end(resampled), [](double ratio) { return ratio <= 1.0; });
+	auto above = std::count_if(std::begin(resampled), std::end(resampled), [](double ratio) { return ratio >= 1.0; });
+	result.pValue = std::min(1.0, 2.0 * std::min(below, above) / resampled.size());
+	result.significant = result.ratioLow > 1.0 || result.ratioHigh < 1.0;
+
+	return result;
+}
+
+void printAbTest(std::ostream& out, const AbTestResult& result, const AbTestSettings& settings, bool perImage)
+{
+	out << "A: " << describe(result.a.config) << std::endl;
+	printResults(out, result.a.results, false);
+	out << "B: " << describe(result.b.config) << std::endl;
+	printResults(out, result.b.results, false);
+
+	if (perImage)
+	{
+		for (size_t i = 0; i < result.imageRatios.size(); ++i)
+		{
+			out << result.a.results.images[i].name << "\t\tB/A " << std::fixed << std::setprecision(4) << result.imageRatios[i] << std::endl;
+		}
+	}
+
+	out << "Throughput B/A " << std::fixed << std::setprecision(4) << result.ratio;
+	out << " [" << result.ratioLow << ", " << result.ratioHigh << "] at " << std::setprecision(0) << settings.confidence * 100.0 << "%, ";
+	out << "p " << std::setprecision(4) << result.pValue << "\t\t";
+	if (!result.significant)
+	{
+		out << "no significant difference" << std::endl;
+	}
+	else
+	{
+		out << (result.ratio > 1.0 ? "B" : "A") << " is faster by " << std::setprecision(1) << (std::max(result.ratio, 1.0 / result.ratio) - 1.0) * 100.0 << "%" << std::endl;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "configuration.hpp"
+#include "report.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct AbTestSettings
+{
+	size_t bootstrapResamples = 10000;
+	// Two-sided, the difference is significant when the interval excludes a ratio of 1
+	double confidence = 0.95;
+	uint64_t seed = 1;
+};
+
+struct AbTestResult
+{
+	ConfigurationResults a;
+	ConfigurationResults b;
+
+	// Throughput of B over A, above 1 when B is faster
+	double ratio = 0.0;
+	double ratioLow = 0.0;
+	double ratioHigh = 0.0;
+	// Two-sided bootstrap p-value of a ratio of 1
+	double pValue = 1.0;
+	bool significant = false;
+
+	// Per image, from the median times of all rounds
+	std::vector<double> imageRatios;
+};
+
+// Compresses every image with A and B back to back, alternating which of them goes first, for
+// settings.warmupRuns untimed and settings.repetitions timed rounds over the data set, so that both
+// see the same thermal state and background load. The ratio is that of the total times over all
+// rounds, its interval comes from a paired bootstrap that resamples images and, for every drawn image,
+// one round of it, so that both the spread over images and the noise between rounds are covered.
+// Images go through the codecs one at a time, settings.threadCount is not used.
+AbTestResult runAbTest(
+	const DataSet& dataSet,
+	const Configuration& a,
+	const Configuration& b,
+	const AbTestSettings& settings,
+	const Benchmark::Settings& benchmarkSettings);
+
+void printAbTest(std::ostream& out, const AbTestResult& result, const AbTestSettings& settings, bool perImage);
@@ -0,0 +1,201 @@
+#include "baseline.hpp"
+#include "cache_state.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+struct BaselineEntry
+{
+	bool hasErrors;
+	double processedBytes;
+	double medianNanoseconds;
+	double spread;
+	double compressionError;
+};
+
+double throughput(double processedBytes, double nanoseconds)
+{
+	return nanoseconds > 0.0 ? processedBytes * 1e9 / nanoseconds : 0.0;
+}
+
+// Names the first run setting of the baseline that differs from the current run
+bool matchesRun(const JsonValue& baselineRun, const RunDescription& run, std::string& difference)
+{
+	auto pipelined = baselineRun.find("pipelined");
+	const std::pair<std::string, std::pair<std::string, std::string>> settings[] =
+	{
+		{ "mode", { baselineRun.stringOr("mode", ""), run.mode } },
+		{ "input", { baselineRun.stringOr("input", ""), run.inputDir } },
+		{ "threadCount", { std::to_string(static_cast<size_t>(baselineRun.numberOr("threadCount", 0.0))), std::to_string(run.settings.threadCount) } },
+		{ "codecThreadCount", { std::to_string(static_cast<size_t>(baselineRun.numberOr("codecThreadCount", 0.0))), std::to_string(run.settings.codecThreadCount) } },
+		{ "cacheState", { baselineRun.stringOr("cacheState", toString(CacheState::Loaded)), toString(run.settings.cacheState) } },
+		{ "pipelined", { pipelined != nullptr && pipelined->boolean ? "true" : "false", run.settings.pipelined ? "true" : "false" } },
+	};
+
+	for (const auto& setting : settings)
+	{
+		if (setting.second.first != setting.second.second)
+		{
+			difference = setting.first + " " + setting.second.first + " in the baseline, " + setting.second.second + " now";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Relative spread of the pass times, (p90 - min) / median. With few repetitions p90 is close to max.
+double relativeSpread(double min, double median, double p90)
+{
+	return median > 0.0 ? std::max(0.0, p90 - min) / median : 0.0;
+}
+
+bool readBaseline(const std::string& fileName, const RunDescription& run, std::vector<std::pair<std::string, BaselineEntry>>& entries)
+{
+	std::ifstream file(fileName);
+	if (!file)
+	{
+		std::cerr << "Failed to open baseline " << fileName << std::endl;
+		return false;
+	}
+
+	std::stringstream text;
+	text << file.rdbuf();
+
+	JsonValue root;
+	if (!parseJson(text.str(), root))
+	{
+		std::cerr << "Baseline " << fileName << " is not valid JSON" << std::endl;
+		return false;
+	}
+
+	auto baselineRun = root.find("run");
+	std::string difference;
+	if (baselineRun == nullptr)
+	{
+		std::cerr << "Baseline " << fileName << " has no run settings" << std::endl;
+		return false;
+	}
+	if (!matchesRun(*baselineRun, run, difference))
+	{
+		std::cerr << "Baseline " << fileName << " isn't comparable, " << difference << std::endl;
+		return false;
+	}
+
+	auto results = root.find("results");
+	if (results == nullptr || results->type != JsonValue::Type::Array)
+	{
+		std::cerr << "Baseline " << fileName << " has no results" << std::endl;
+		return false;
+	}
+
+	for (const auto& result : results->array)
+	{
+		auto pass = result.find("passNanoseconds");
+		auto hasErrors = result.find("hasErrors");
+		if (pass == nullptr)
+		{
+			continue;
+		}
+
+		BaselineEntry entry;
+		entry.hasErrors = hasErrors != nullptr && hasErrors->boolean;
+		entry.processedBytes = result.numberOr("processedBytes", 0.0);
+		entry.medianNanoseconds = pass->numberOr("median", 0.0);
+		entry.spread = relativeSpread(pass->numberOr("min", 0.0), entry.medianNanoseconds, pass->numberOr("p90", 0.0));
+		entry.compressionError = result.numberOr("compressionError", 0.0);
+		entries.emplace_back(result.stringOr("configuration", ""), entry);
+	}
+
+	return true;
+}
+} // namespace
+
+bool compareWithBaseline(
+	std::ostream& out,
+	const std::string& baselineFile,
+	const RunDescription& run,
+	const std::vector<ConfigurationResults>& allResults,
+	const BaselineThresholds& thresholds,
+	size_t& regressionCount)
+{
+	std::vector<std::pair<std::string, BaselineEntry>> entries;
+	if (!readBaseline(baselineFile, run, entries))
+	{
+		return false;
+	}
+
+	regressionCount = 0;
+
+	out << std::endl << "Comparison with " << baselineFile << std::endl;
+	for (const auto& current : allResults)
+	{
+		auto name = describe(current.config);
+		auto it = std::find_if(std::begin(entries), std::end(entries), [&](const auto& entry) { return entry.first == name; });
+		if (it == std::end(entries))
+		{
+			out << name << "\t\tnot in baseline" << std::endl;
+			continue;
+		}
+
+		const auto& baseline = it->second;
+		const auto& results = current.results;
+		const auto& pass = results.passNanoseconds;
+
+		// Failed images also shrink the processed bytes, so they're a regression before they make the run incomparable
+		auto newErrors = results.hasErrors && !baseline.hasErrors;
+		if (newErrors && baseline.processedBytes != static_cast<double>(results.processedBytes))
+		{
+			++regressionCount;
+			out << name << "\t\tREGRESSION failures, " << results.processedBytes << " of ";
+			out << static_cast<size_t>(baseline.processedBytes) << " baseline bytes processed" << std::endl;
+			continue;
+		}
+
+		// Another data set or a cut pass, throughput and error would be of other images
+		if (baseline.processedBytes != static_cast<double>(results.processedBytes))
+		{
+			out << name << "\t\tnot comparable, " << static_cast<size_t>(baseline.processedBytes) << " bytes processed in the baseline, ";
+			out << results.processedBytes << " now" << std::endl;
+			continue;
+		}
+
+		auto baselineThroughput = throughput(baseline.processedBytes, baseline.medianNanoseconds);
+		auto throughputChange = baselineThroughput > 0.0 ? throughput(static_cast<double>(results.processedBytes), pass.median) / baselineThroughput - 1.0 : 0.0;
+		auto timeTolerance = std::max(thresholds.timeTolerance, baseline.spread + relativeSpread(pass.min, pass.median, pass.p90));
+		auto errorChange = baseline.compressionError > 0.0 ? results.compressionError / baseline.compressionError - 1.0 : 0.0;
+
+		auto slower = throughputChange < -timeTolerance;
+		auto worseError = errorChange > thresholds.errorTolerance ||
+			(baseline.compressionError == 0.0 && results.compressionError > 0.0);
+
+		out << name << "\t\t";
+		out << "Throughput " << std::showpos << std::fixed << std::setprecision(1) << throughputChange * 100.0 << "%";
+		out << std::noshowpos << " (tolerance " << timeTolerance * 100.0 << "%)\t\t";
+		out << "Error " << std::showpos << std::setprecision(3) << errorChange * 100.0 << "%" << std::noshowpos << "\t\t";
+
+		if (slower || worseError || newErrors)
+		{
+			++regressionCount;
+			out << "REGRESSION";
+			out << (slower ? " throughput" : "") << (worseError ? " error" : "") << (newErrors ? " failures" : "");
+		}
+		else if (throughputChange > timeTolerance)
+		{
+			out << "faster";
+		}
+		else
+		{
+			out << "ok";
+		}
+		out << std::endl;
+	}
+
+	return true;
+}
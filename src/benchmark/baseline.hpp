@@ -0,0 +1,30 @@
+#pragma once
+
+#include "report.hpp"
+#include "results_file.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BaselineThresholds
+{
+	// Smallest relative drop of the throughput of the median pass that counts as a regression.
+	// The spread of both runs is added on top, so noisy measurements need a larger change.
+	double timeTolerance = 0.05;
+	// Relative RMSE increase that counts as a regression
+	double errorTolerance = 0.001;
+};
+
+// Compares results against a file written by writeJsonResults, matching configurations by
+// describe(config), and prints one line per configuration. Configurations missing from the
+// baseline, or that processed a different number of bytes, are reported but not counted.
+// Returns false when the baseline can't be read or was made with other run settings
+// (mode, input, threads, codec threads, cache state, pipelining), as its numbers mean something else.
+bool compareWithBaseline(
+	std::ostream& out,
+	const std::string& baselineFile,
+	const RunDescription& run,
+	const std::vector<ConfigurationResults>& allResults,
+	const BaselineThresholds& thresholds,
+	size_t& regressionCount);
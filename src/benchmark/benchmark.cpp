@@ -1,190 +1,1046 @@
 #include "benchmark.hpp"
 
+#include "configuration.hpp"
+#include "dataset.hpp"
+#include "error_calculator.hpp"
+#include "parallel.hpp"
+#include "pipeline.hpp"
+#include "progress.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+
 #include <png_utils.hpp>
 
-#include <chrono>
-#include <filesystem>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <thread>
 
 namespace
 {
-bool endsWith(std::string const& str, std::string const& ending)
+size_t blockCount(const UncompressedImage& image)
+{
+	return ((image.width + 3) / 4) * ((image.height + 3) / 4);
+}
+
+// Upper bound for every supported format, BC1 and BC4 use half of it
+size_t maxCompressedSize(size_t width, size_t height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+}
+
+struct Timings
+{
+	std::vector<std::vector<double>> nanoseconds;
+	std::vector<std::vector<double>> cycles;
+	std::vector<double> passNanoseconds;
+	std::vector<PerfCounterValues> counters;
+	std::vector<MemoryUsage> memory;
+	std::vector<char> failed;
+	EnergyUsage energy;
+	// Set when the time budget ended the passes early. Items that no measured pass timed
+	// then keep their last warmup call, items that weren't reached at all have no samples.
+	bool cut = false;
+};
+
+// Makes settings.warmupRuns untimed and settings.repetitions timed passes of
+// operation(index, threadIndex) over the images of dataSet on threadCount threads.
+// Every timed call is traced as a zone of zoneName with the name of its image.
+// Items are handed out through a shared queue, or statically when images are placed on NUMA nodes.
+// An item that failed once is skipped afterwards. Caches are brought into settings.cacheState
+// before every item, the time that takes is subtracted from the pass evenly over the threads.
+// Passes that the time budget cut short aren't counted, nor is the energy of any pass then.
+// Energy also includes preparing the caches, so it's only measured with the caches left as loaded.
+template <typename Operation>
+Timings timePasses(const Benchmark::Settings& settings, const DataSet& dataSet, size_t threadCount, const char* zoneName, Operation&& operation)
+{
+	auto itemCount = dataSet.size();
+
+	Timings timings;
+	timings.nanoseconds.resize(itemCount);
+	timings.cycles.resize(itemCount);
+	timings.counters.resize(itemCount);
+	timings.memory.resize(itemCount);
+	timings.failed.resize(itemCount, 0);
+
+	std::unique_ptr<CacheEvictor> evictor;
+	if (settings.cacheState == CacheState::Cold)
+	{
+		evictor = std::make_unique<CacheEvictor>();
+	}
+
+	auto repetitions = std::max<size_t>(settings.repetitions, 1);
+	auto passCount = settings.warmupRuns + repetitions;
+
+	std::unique_ptr<ProgressReporter> progress;
+	if (settings.progress)
+	{
+		progress = std::make_unique<ProgressReporter>(itemCount * passCount, settings.timeBudgetSeconds);
+	}
+
+	// Checked before an item is taken, so that the items being worked on are finished
+	auto runStart = Clock::now();
+	std::atomic<bool> budgetReached = false;
+	auto withinBudget = [&]()
+	{
+		if (settings.timeBudgetSeconds > 0.0 && elapsedNanoseconds(runStart, Clock::now()) * 1e-9 > settings.timeBudgetSeconds)
+		{
+			budgetReached = true;
+		}
+
+		return !budgetReached;
+	};
+
+	std::vector<double> warmupNanoseconds(itemCount, -1.0);
+	std::vector<double> warmupCycles(itemCount, 0.0);
+
+	EnergyMeter energy;
+	auto measureEnergy = settings.cacheState == CacheState::Loaded;
+	for (size_t pass = 0; pass < passCount && !timings.cut; ++pass)
+	{
+		auto measured = pass >= settings.warmupRuns;
+		if (pass == settings.warmupRuns && measureEnergy)
+		{
+			energy.start();
+		}
+
+		// Every item index is taken by exactly one worker per pass,
+		// so the per-item slots are written without synchronization
+		WorkQueue queue(itemCount);
+		std::atomic<size_t> itemsTaken = 0;
+		std::vector<uint64_t> preparationNanoseconds(threadCount, 0);
+		auto passStart = Clock::now();
+		runOnThreads(threadCount, [&](size_t threadIndex)
+		{
+			ThreadPinning pinning(settings.placement, threadIndex);
+			TraceThreadName traceName("worker " + std::to_string(threadIndex));
+
+			// Counters belong to the thread that opens them, so every worker needs its own
+			std::unique_ptr<PerfCounters> counters;
+			if (measured && settings.perfCounters)
+			{
+				counters = std::make_unique<PerfCounters>();
+			}
+
+			// Images placed on a NUMA node stay with the worker on that node
+			auto placed = settings.placement.numa != NumaPlacement::None;
+			StridedQueue ownItems(itemCount, threadIndex, threadCount);
+
+			// Preparation, the timed call and its bookkeeping of item i
+			auto runItem = [&](size_t i)
+			{
+				if (timings.failed[i])
+				{
+					return;
+				}
+
+				if (settings.cacheState != CacheState::Loaded)
+				{
+					auto preparationStart = Clock::now();
+					if (evictor)
+					{
+						evictor->evict();
+					}
+					else if (!operation(i, threadIndex))
+					{
+						timings.failed[i] = 1;
+						return;
+					}
+					preparationNanoseconds[threadIndex] += elapsedNanoseconds(preparationStart, Clock::now());
+				}
+
+				// The memory snapshots read /proc and stay outside of the counted and timed region,
+				// so does the bookkeeping of the zone
+				TraceZone zone(zoneName, dataSet[i].name);
+				MemoryMeasurement memory;
+				if (measured && settings.memoryStats)
+				{
+					memory.start();
+				}
+				if (counters)
+				{
+					counters->start();
+				}
+				auto startCycles = readCycleCounter();
+				auto start = Clock::now();
+				auto succeeded = operation(i, threadIndex);
+				auto end = Clock::now();
+				auto endCycles = readCycleCounter();
+				if (counters)
+				{
+					counters->stop(timings.counters[i]);
+				}
+				if (measured && settings.memoryStats)
+				{
+					memory.stop(timings.memory[i]);
+				}
+
+				if (!succeeded)
+				{
+					timings.failed[i] = 1;
+					return;
+				}
+
+				if (measured)
+				{
+					timings.nanoseconds[i].push_back(static_cast<double>(elapsedNanoseconds(start, end)));
+					timings.cycles[i].push_back(static_cast<double>(endCycles - startCycles));
+				}
+				else
+				{
+					warmupNanoseconds[i] = static_cast<double>(elapsedNanoseconds(start, end));
+					warmupCycles[i] = static_cast<double>(endCycles - startCycles);
+				}
+			};
+
+			size_t i;
+			while (withinBudget() && (placed ? ownItems.pop(i) : queue.pop(i)))
+			{
+				itemsTaken.fetch_add(1, std::memory_order_relaxed);
+				runItem(i);
+
+				// Once the item is done, so that the estimate doesn't run ahead by the items in flight
+				if (progress)
+				{
+					progress->advance();
+				}
+			}
+		});
+		auto passEnd = Clock::now();
+
+		timings.cut = itemsTaken < itemCount;
+		if (measured && !timings.cut)
+		{
+			double preparation = 0.0;
+			for (auto nanoseconds : preparationNanoseconds)
+			{
+				preparation += static_cast<double>(nanoseconds) / threadCount;
+			}
+			timings.passNanoseconds.push_back(static_cast<double>(elapsedNanoseconds(passStart, passEnd)) - preparation);
+		}
+	}
+
+	if (!timings.cut)
+	{
+		if (measureEnergy)
+		{
+			energy.stop(timings.energy, repetitions);
+		}
+		return timings;
+	}
+
+	for (size_t i = 0; i < itemCount; ++i)
+	{
+		if (timings.nanoseconds[i].empty() && warmupNanoseconds[i] >= 0.0)
+		{
+			timings.nanoseconds[i].push_back(warmupNanoseconds[i]);
+			timings.cycles[i].push_back(warmupCycles[i]);
+		}
+	}
+
+	return timings;
+}
+
+// Least squares fit of the median times of the timed images to their pixel counts. A fit that
+// makes either term negative, or has only one image size to go by, becomes a cost per pixel.
+Benchmark::Extrapolation fitImageCost(const DataSet& dataSet, const Timings& timings)
+{
+	Benchmark::Extrapolation fit;
+	std::vector<std::pair<double, double>> points;
+	for (size_t i = 0, n = dataSet.size(); i < n; ++i)
+	{
+		if (!timings.failed[i])
+		{
+			++fit.totalImages;
+		}
+		if (!timings.failed[i] && !timings.nanoseconds[i].empty())
+		{
+			const auto& image = dataSet[i].image;
+			points.emplace_back(static_cast<double>(image.width) * image.height, computeStatistics(timings.nanoseconds[i]).median);
+		}
+	}
+
+	fit.applied = true;
+	fit.timedImages = points.size();
+	if (points.empty())
+	{
+		return fit;
+	}
+
+	double meanPixels = 0.0;
+	double meanNanoseconds = 0.0;
+	for (const auto& point : points)
+	{
+		meanPixels += point.first / points.size();
+		meanNanoseconds += point.second / points.size();
+	}
+
+	double covariance = 0.0;
+	double variance = 0.0;
+	for (const auto& point : points)
+	{
+		covariance += (point.first - meanPixels) * (point.second - meanNanoseconds);
+		variance += (point.first - meanPixels) * (point.first - meanPixels);
+	}
+
+	fit.nanosecondsPerPixel = variance > 0.0 ? covariance / variance : 0.0;
+	fit.nanosecondsPerImage = meanNanoseconds - fit.nanosecondsPerPixel * meanPixels;
+	if (variance <= 0.0 || fit.nanosecondsPerPixel < 0.0 || fit.nanosecondsPerImage < 0.0)
+	{
+		fit.nanosecondsPerPixel = meanPixels > 0.0 ? meanNanoseconds / meanPixels : 0.0;
+		fit.nanosecondsPerImage = 0.0;
+	}
+
+	return fit;
+}
+
+// Fills the timing part of the results, processed bytes are the RGBA bytes of the images that succeeded.
+// When the time budget left no whole measured pass, images that weren't timed count as processed and
+// the pass time is their fitted time plus that of the timed images, spread evenly over the threads.
+Benchmark::Results makeResults(const DataSet& dataSet, const Timings& timings, size_t threadCount)
+{
+	Benchmark::Results results;
+	results.hasErrors = false;
+	results.processedBytes = 0;
+	results.compressionError = 0.0f;
+	results.threadCount = threadCount;
+	results.codecThreadCount = 0;
+	results.peakResidentBytes = 0;
+	results.perfCounterBlocks = 0;
+
+	size_t processedBlocks = 0;
+	for (size_t i = 0, n = dataSet.size(); i < n; ++i)
+	{
+		const auto& image = dataSet[i].image;
+		if (timings.failed[i])
+		{
+			results.hasErrors = true;
+			continue;
+		}
+
+		results.processedBytes += image.bytes.size();
+		processedBlocks += blockCount(image);
+		if (timings.nanoseconds[i].empty())
+		{
+			continue;
+		}
+
+		Benchmark::ImageResults imageResults;
+		imageResults.name = dataSet[i].name;
+		imageResults.width = image.width;
+		imageResults.height = image.height;
+		imageResults.elapsedNanoseconds = computeStatistics(timings.nanoseconds[i]);
+		imageResults.cyclesPerBlock = computeStatistics(timings.cycles[i]).median / blockCount(image);
+		imageResults.memory = timings.memory[i];
+		results.images.push_back(std::move(imageResults));
+
+		results.memory.addSequential(timings.memory[i]);
+
+		results.perfCounters.add(timings.counters[i]);
+		results.perfCounterBlocks += blockCount(image) * timings.counters[i].measurements;
+	}
+
+	results.passNanoseconds = computeStatistics(timings.passNanoseconds);
+	if (timings.cut && timings.passNanoseconds.empty())
+	{
+		results.extrapolation = fitImageCost(dataSet, timings);
+
+		double nanoseconds = 0.0;
+		for (size_t i = 0, n = dataSet.size(); i < n; ++i)
+		{
+			const auto& image = dataSet[i].image;
+			if (timings.failed[i])
+			{
+				continue;
+			}
+
+			nanoseconds += timings.nanoseconds[i].empty() ?
+				results.extrapolation.nanosecondsPerImage + results.extrapolation.nanosecondsPerPixel * image.width * image.height :
+				computeStatistics(timings.nanoseconds[i]).median;
+		}
+
+		auto pass = nanoseconds / threadCount;
+		results.passNanoseconds = { pass, pass, pass, pass, pass };
+	}
+	results.elapsedSeconds = results.passNanoseconds.median * 1e-9;
+	results.energy = timings.energy;
+	results.nanosecondsPerBlock = processedBlocks > 0 ? results.passNanoseconds.median / processedBlocks : 0.0;
+
+	auto throughput = results.elapsedSeconds > 0.0 ? results.processedBytes / results.elapsedSeconds : 0.0;
+	results.throughputBytesPerSec = static_cast<size_t>(throughput);
+
+	return results;
+}
+
+// Heatmaps only differ between configurations, so repeated measurements of one leave them out
+Benchmark::Settings withoutHeatmaps(Benchmark::Settings settings)
+{
+	settings.blockErrors.heatmapDir.clear();
+	return settings;
+}
+
+// Full-image metrics need the decompressed image, RMSE alone is computed block by block while decoding
+bool needsDecompressedImage(const MetricSelection& metrics)
+{
+	return metrics.any();
+}
+
+bool addImageError(
+	const DataSetImage& source,
+	const CompressedImage& compressed,
+	const Benchmark::Settings& settings,
+	size_t channels,
+	size_t threadCount,
+	ErrorCalculator& calculator,
+	MetricsCalculator& metricsCalculator,
+	BlockErrorReport& blockErrors)
 {
-	if (str.length() >= ending.length())
+	TraceZone zone("image error", source.name);
+
+	const auto& uncompressed = source.image;
+	auto decompress = needsDecompressedImage(settings.metrics);
+
+	// RMSE always comes from the block decoder, so that it doesn't depend on which metrics are selected
+	if (settings.blockErrors.enabled())
+	{
+		uint64_t squaredErrorSum = 0;
+		if (!analyzeBlockErrors(source, compressed, channels, settings.blockErrors, threadCount, squaredErrorSum, blockErrors))
+		{
+			std::cerr << "Failed to decompress image" << std::endl;
+			return false;
+		}
+
+		calculator.addSquaredErrors(squaredErrorSum, static_cast<uint64_t>(uncompressed.width) * uncompressed.height * channels);
+	}
+	else if (!calculator.addCompressedSamples(uncompressed, compressed))
+	{
+		std::cerr << "Failed to decompress image" << std::endl;
+		return false;
+	}
+
+	if (!decompress)
+	{
+		return true;
+	}
+
+	UncompressedImage decompressed;
 	{
-		return str.compare(str.length() - ending.length(), ending.length(), ending) == 0;
+		TraceZone decompressZone("genericDecompress", source.name);
+		if (!genericDecompress(compressed, UncompressedFormat::RGBA8, decompressed))
+		{
+			std::cerr << "Failed to decompress image" << std::endl;
+			return false;
+		}
 	}
-	else
+
+	if (uncompressed.bytes.size() != decompressed.bytes.size())
 	{
+		std::cerr << "Image has a different size after the decompression" << std::endl;
 		return false;
 	}
+
+	metricsCalculator.addImage(uncompressed, decompressed);
+	return true;
 }
 
-size_t relevantChannels(CompressedFormat format)
+// Per-image block error reports go to the matching entries of results.images,
+// which makeResults() only fills with the images that didn't fail and were timed
+void accumulateError(
+	const DataSet& dataSet,
+	const std::vector<CompressedImage>& compressedImages,
+	const Timings& timings,
+	CompressedFormat format,
+	const Benchmark::Settings& settings,
+	Benchmark::Results& results)
 {
-	switch (format)
+	TraceZone zone("accumulate error");
+
+	auto channels = relevantChannels(format);
+	ErrorCalculator calculator(channels, hardwareThreadCount());
+	MetricsCalculator metricsCalculator(settings.metrics, channels, hardwareThreadCount());
+	for (size_t i = 0, image = 0, n = dataSet.size(); i < n; ++i)
 	{
-	case CompressedFormat::BC1: return 3;
-	case CompressedFormat::BC3: return 3;
-	case CompressedFormat::BC4: return 1;
-	case CompressedFormat::BC5: return 2;
-	case CompressedFormat::BC6: return 3;
-	case CompressedFormat::BC7: return 3;
-	default: return 4;
+		const auto& compressed = compressedImages[i];
+		if (compressed.bytes.empty() || timings.failed[i])
+		{
+			continue;
+		}
+
+		BlockErrorReport blockErrors;
+		if (!addImageError(dataSet[i], compressed, settings, channels, hardwareThreadCount(), calculator, metricsCalculator, blockErrors))
+		{
+			results.hasErrors = true;
+		}
+
+		if (!timings.nanoseconds[i].empty())
+		{
+			results.images[image++].blockErrors = std::move(blockErrors);
+		}
 	}
+
+	results.compressionError = calculator.calculateError();
+	results.quality = metricsCalculator.calculate();
+}
+
+// The whole data set and all compressed images stay resident, plus one decompressed image at a time if needed
+size_t residentBytes(const DataSet& dataSet, const std::vector<CompressedImage>& compressedImages, const MetricSelection& metrics)
+{
+	size_t largestImageBytes = 0;
+	size_t result = 0;
+	for (size_t i = 0, n = dataSet.size(); i < n; ++i)
+	{
+		largestImageBytes = std::max(largestImageBytes, dataSet[i].image.bytes.size());
+		result += dataSet[i].image.bytes.size() + compressedImages[i].bytes.size();
+	}
+
+	return result + (needsDecompressedImage(metrics) ? largestImageBytes : 0);
+}
+
+// Concurrent images times threads inside the codec stays within the hardware threads
+size_t codecThreadBudget(const Benchmark::Settings& settings, size_t threadCount)
+{
+	if (settings.codecThreadCount > 0)
+	{
+		return settings.codecThreadCount;
+	}
+
+	return threadCount > 1 ? std::max<size_t>(hardwareThreadCount() / threadCount, 1) : 0;
+}
+
+Benchmark::Results measure(
+	Codec& codec,
+	const Benchmark::Settings& settings,
+	const DataSet& dataSet,
+	CompressedFormat format,
+	size_t threadCount)
+{
+	codec.setThreadCount(codecThreadBudget(settings, threadCount));
+
+	std::vector<CompressedImage> compressedImages(dataSet.size());
+	auto timings = timePasses(settings, dataSet, threadCount, "compress", [&](size_t i, size_t)
+	{
+		if (!codec.compress(dataSet[i].image, format, compressedImages[i]))
+		{
+			std::cerr << "Failed to compress image " << dataSet[i].name << std::endl;
+			compressedImages[i].bytes.clear();
+			return false;
+		}
+
+		return true;
+	});
+
+	auto results = makeResults(dataSet, timings, threadCount);
+	accumulateError(dataSet, compressedImages, timings, format, settings, results);
+	results.peakResidentBytes = residentBytes(dataSet, compressedImages, settings.metrics);
+	results.codecThreadCount = codec.threadCount();
+
+	return results;
+}
+
+// Appends the passes of a later run of timePasses over the same items
+void appendTimings(Timings& timings, const Timings& other)
+{
+	for (size_t i = 0, n = timings.nanoseconds.size(); i < n; ++i)
+	{
+		timings.nanoseconds[i].insert(std::end(timings.nanoseconds[i]), std::begin(other.nanoseconds[i]), std::end(other.nanoseconds[i]));
+		timings.cycles[i].insert(std::end(timings.cycles[i]), std::begin(other.cycles[i]), std::end(other.cycles[i]));
+		timings.counters[i].add(other.counters[i]);
+		timings.memory[i].addRepetition(other.memory[i]);
+		timings.failed[i] = timings.failed[i] || other.failed[i];
+	}
+	timings.cut = timings.cut || other.cut;
+	timings.passNanoseconds.insert(std::end(timings.passNanoseconds), std::begin(other.passNanoseconds), std::end(other.passNanoseconds));
+
+	auto& energy = timings.energy;
+	energy.available = energy.available && other.energy.available;
+	energy.passes += other.energy.passes;
+	energy.packageJoules += other.energy.packageJoules;
+	energy.dramJoules += other.energy.dramJoules;
+	energy.seconds += other.energy.seconds;
 }
 
-UncompressedImage makeImageFromPngReadback(const PngUtils::Readback& readback)
+Benchmark::Results measureDecompression(
+	const Benchmark::Settings& settings,
+	const DataSet& dataSet,
+	const std::vector<CompressedImage>& compressedImages,
+	CompressedFormat format,
+	size_t threadCount)
 {
-	UncompressedImage image;
-	image.format = UncompressedFormat::RGBA8;
-	image.width = readback.width;
-	image.height = readback.height;
+	// Each worker decodes into its own image, whose storage is reused between calls. DirectXTex still
+	// allocates a scratch image of the whole output per call, which is part of the timed decode.
+	std::vector<UncompressedImage> outputs(threadCount);
+	auto timings = timePasses(settings, dataSet, threadCount, "genericDecompress", [&](size_t i, size_t threadIndex)
+	{
+		if (compressedImages[i].bytes.empty())
+		{
+			return false;
+		}
+
+		if (!genericDecompress(compressedImages[i], UncompressedFormat::RGBA8, outputs[threadIndex]))
+		{
+			std::cerr << "Failed to decompress image " << dataSet[i].name << std::endl;
+			return false;
+		}
 
-	auto size = image.width * image.height * 4;
-	image.bytes.reserve(size);
+		return true;
+	});
 
-	auto begin = readback.data.get();
-	auto end = begin + size;
-	std::copy(begin, end, std::back_inserter(image.bytes));
+	auto results = makeResults(dataSet, timings, threadCount);
+	accumulateError(dataSet, compressedImages, timings, format, settings, results);
+	results.peakResidentBytes = residentBytes(dataSet, compressedImages, settings.metrics);
 
-	return image;
+	return results;
 }
 
-std::vector<UncompressedImage> loadDataSet(const std::string& dir)
+struct PipelineItem
+{
+	size_t index;
+	DataSetImage source;
+	CompressedImage compressed;
+	size_t reservedBytes;
+};
+
+// Timings of one image of the stream over all passes, each written by the worker that got the image in that pass
+struct PipelineImage
 {
-	std::vector<PngUtils::Readback> readbacks;
-	for (const auto& entry : std::filesystem::directory_iterator(dir))
+	std::string name;
+	size_t width = 0;
+	size_t height = 0;
+	bool loaded = false;
+	bool failed = false;
+	std::vector<double> nanoseconds;
+	std::vector<double> cycles;
+	PerfCounterValues counters;
+	BlockErrorReport blockErrors;
+};
+
+// Streams the data set through three stages connected by bounded queues, once per pass:
+// PNG decode on a loader thread, compression on threadCount workers and, in an unmeasured pass,
+// decompression with error accumulation on a verifier thread. The pass time is the sum of the
+// compress calls over the workers, the wall clock from the first load until the workers are done
+// is reported next to it. The memory budget covers the PNG readback too.
+Benchmark::Results measurePipelined(
+	Codec& codec,
+	const Benchmark::Settings& settings,
+	const std::string& contentDir,
+	CompressedFormat format)
+{
+	Benchmark::Results results;
+	results.hasErrors = false;
+	results.processedBytes = 0;
+	results.compressionError = 0.0f;
+	results.threadCount = settings.threadCount;
+	results.perfCounterBlocks = 0;
+
+	auto paths = listDataSet(contentDir);
+	auto threadCount = std::max<size_t>(settings.threadCount, 1);
+	codec.setThreadCount(codecThreadBudget(settings, threadCount));
+	results.codecThreadCount = codec.threadCount();
+	auto repetitions = std::max<size_t>(settings.repetitions, 1);
+
+	MemoryBudget budget(settings.memoryBudgetBytes);
+	std::vector<PipelineImage> images(paths.size());
+	std::atomic<bool> hasErrors = false;
+
+	ErrorCalculator calculator(relevantChannels(format));
+	MetricsCalculator metricsCalculator(settings.metrics, relevantChannels(format));
+
+	// The verifier competes with the workers for cores, so it runs in the last warmup pass,
+	// or in an extra pass after the measured ones when there is no warmup
+	auto verifiedPass = settings.warmupRuns > 0 ? settings.warmupRuns - 1 : repetitions;
+	auto passCount = settings.warmupRuns + repetitions + (settings.warmupRuns > 0 ? 0 : 1);
+
+	std::vector<double> passNanoseconds;
+	std::vector<double> wallNanoseconds;
+	for (size_t pass = 0; pass < passCount; ++pass)
 	{
-		const auto& path = entry.path().string();
-		if (endsWith(path, ".png"))
+		auto measured = pass >= settings.warmupRuns && pass < settings.warmupRuns + repetitions;
+		auto verified = pass == verifiedPass;
+		std::vector<double> threadNanoseconds(threadCount, 0.0);
+
+		BoundedQueue<std::unique_ptr<PipelineItem>> compressQueue(threadCount * 2);
+		BoundedQueue<std::unique_ptr<PipelineItem>> verifyQueue(threadCount * 2);
+
+		auto passStart = Clock::now();
+		std::thread loader([&]()
+		{
+			TraceThreadName traceName("loader");
+			for (size_t i = 0; i < paths.size(); ++i)
+			{
+				size_t width, height;
+				if (!PngUtils::readPngSize(paths[i].c_str(), width, height))
+				{
+					std::cerr << "Failed to load image" << paths[i] << std::endl;
+					hasErrors = true;
+					continue;
+				}
+
+				// Source RGBA and the compressed output stay alive until the item is released,
+				// the decompressed image only exists when full-image metrics are requested.
+				// The PNG readback only lives while the image is being loaded.
+				auto item = std::make_unique<PipelineItem>();
+				item->index = i;
+				auto imageBytes = width * height * 4;
+				item->reservedBytes = imageBytes + maxCompressedSize(width, height) +
+					(verified && needsDecompressedImage(settings.metrics) ? imageBytes : 0);
+				{
+					TraceZone zone("wait for memory budget");
+					budget.acquire(item->reservedBytes + imageBytes);
+				}
+
+				auto loaded = loadImage(paths[i], item->source);
+				budget.release(loaded ? imageBytes : item->reservedBytes + imageBytes);
+				if (!loaded)
+				{
+					hasErrors = true;
+					continue;
+				}
+
+				auto& image = images[i];
+				image.name = item->source.name;
+				image.width = item->source.image.width;
+				image.height = item->source.image.height;
+				image.loaded = true;
+				compressQueue.push(std::move(item));
+			}
+
+			compressQueue.close();
+		});
+
+		std::thread verifier([&]()
 		{
-			auto readback = PngUtils::readPng(path.c_str());
-			if (readback.data == nullptr)
+			TraceThreadName traceName("verifier");
+			std::unique_ptr<PipelineItem> item;
+			while (verifyQueue.pop(item))
 			{
-				std::cerr << "Failed to load image" << path << std::endl;
+				auto& image = images[item->index];
+				if (item->compressed.bytes.empty() ||
+					!addImageError(item->source, item->compressed, settings, relevantChannels(format), 1, calculator, metricsCalculator, image.blockErrors))
+				{
+					hasErrors = true;
+				}
+
+				budget.release(item->reservedBytes);
+				item.reset();
 			}
-			else if (readback.format != PngUtils::Format::RGBA)
+		});
+
+		runOnThreads(threadCount, [&](size_t threadIndex)
+		{
+			ThreadPinning pinning(settings.placement, threadIndex);
+			TraceThreadName traceName("worker " + std::to_string(threadIndex));
+
+			std::unique_ptr<PerfCounters> counters;
+			if (measured && settings.perfCounters)
 			{
-				std::cerr << "Image has unsupported format " << path << std::endl;
+				counters = std::make_unique<PerfCounters>();
 			}
-			else
+
+			std::unique_ptr<PipelineItem> item;
+			while (compressQueue.pop(item))
 			{
-				readbacks.push_back(std::move(readback));
+				auto& image = images[item->index];
+				const auto& uncompressed = item->source.image;
+				if (!image.failed)
+				{
+					TraceZone zone("compress", item->source.name);
+					if (counters)
+					{
+						counters->start();
+					}
+					auto startCycles = readCycleCounter();
+					auto start = Clock::now();
+					auto succeeded = codec.compress(uncompressed, format, item->compressed);
+					auto end = Clock::now();
+					auto endCycles = readCycleCounter();
+					if (counters)
+					{
+						counters->stop(image.counters);
+					}
+
+					if (!succeeded)
+					{
+						std::cerr << "Failed to compress image " << item->source.name << std::endl;
+						item->compressed.bytes.clear();
+						image.failed = true;
+					}
+					else if (measured)
+					{
+						threadNanoseconds[threadIndex] += static_cast<double>(elapsedNanoseconds(start, end));
+						image.nanoseconds.push_back(static_cast<double>(elapsedNanoseconds(start, end)));
+						image.cycles.push_back(static_cast<double>(endCycles - startCycles) / blockCount(uncompressed));
+					}
+				}
+
+				if (verified)
+				{
+					verifyQueue.push(std::move(item));
+				}
+				else
+				{
+					budget.release(item->reservedBytes);
+					item.reset();
+				}
 			}
+		});
+		auto passEnd = Clock::now();
+
+		verifyQueue.close();
+		loader.join();
+		verifier.join();
+
+		// Only the compress calls count as the pass time, the workers' waits on the loader don't
+		if (measured)
+		{
+			auto nanoseconds = std::accumulate(std::begin(threadNanoseconds), std::end(threadNanoseconds), 0.0);
+			passNanoseconds.push_back(nanoseconds / threadCount);
+			wallNanoseconds.push_back(static_cast<double>(elapsedNanoseconds(passStart, passEnd)));
 		}
 	}
 
-	std::vector<UncompressedImage> result;
-	result.reserve(readbacks.size());
+	size_t processedBlocks = 0;
+	for (auto& image : images)
+	{
+		if (!image.loaded)
+		{
+			continue;
+		}
+		if (image.failed)
+		{
+			hasErrors = true;
+			continue;
+		}
+
+		auto blocks = ((image.width + 3) / 4) * ((image.height + 3) / 4);
+		results.processedBytes += image.width * image.height * 4;
+		processedBlocks += blocks;
 
-	std::transform(
-		std::begin(readbacks), std::end(readbacks),
-		std::back_inserter(result), &makeImageFromPngReadback);
+		Benchmark::ImageResults imageResults;
+		imageResults.name = image.name;
+		imageResults.width = image.width;
+		imageResults.height = image.height;
+		imageResults.elapsedNanoseconds = computeStatistics(image.nanoseconds);
+		imageResults.cyclesPerBlock = computeStatistics(image.cycles).median;
+		imageResults.blockErrors = std::move(image.blockErrors);
+		results.images.push_back(std::move(imageResults));
 
-	return result;
+		results.perfCounters.add(image.counters);
+		results.perfCounterBlocks += blocks * image.counters.measurements;
+	}
+
+	results.hasErrors = hasErrors;
+	results.peakResidentBytes = budget.peakBytes();
+	results.passNanoseconds = computeStatistics(passNanoseconds);
+	results.wallNanoseconds = computeStatistics(wallNanoseconds);
+	results.elapsedSeconds = results.passNanoseconds.median * 1e-9;
+	results.nanosecondsPerBlock = processedBlocks > 0 ? results.passNanoseconds.median / processedBlocks : 0.0;
+
+	auto throughput = results.elapsedSeconds > 0.0 ? results.processedBytes / results.elapsedSeconds : 0.0;
+	results.throughputBytesPerSec = static_cast<size_t>(throughput);
+
+	results.compressionError = calculator.calculateError();
+	results.quality = metricsCalculator.calculate();
+
+	return results;
+}
+} // namespace
+
+Benchmark::Results Benchmark::run(const std::string& contentDir, CompressedFormat format)
+{
+	if (m_settings.pipelined)
+	{
+		return measurePipelined(m_codec, m_settings, contentDir, format);
+	}
+
+	return run(loadDataSet(contentDir), format);
 }
 
-class ErrorCalculator
+Benchmark::Results Benchmark::run(const DataSet& dataSet, CompressedFormat format)
 {
-public:
-	ErrorCalculator(size_t relevantChannels)
-		: m_relevantChannels(relevantChannels)
-	{}
+	return measure(m_codec, m_settings, dataSet, format, m_settings.threadCount);
+}
+
+std::vector<Benchmark::Results> Benchmark::runDecompression(const DataSet& dataSet, CompressedFormat format)
+{
+	std::vector<CompressedImage> compressedImages(dataSet.size());
+
+	m_codec.setThreadCount(codecThreadBudget(m_settings, m_settings.threadCount));
 
-	void addSamples(const UncompressedImage& image0, const UncompressedImage& image1)
+	WorkQueue queue(dataSet.size());
+	runOnThreads(m_settings.threadCount, [&](size_t)
 	{
-		for (size_t pixel = 0, n = image0.bytes.size(); pixel < n; pixel += 4)
+		size_t i;
+		while (queue.pop(i))
 		{
-			for (size_t channel = 0; channel < m_relevantChannels; ++channel)
+			TraceZone zone("compress", dataSet[i].name);
+			if (!m_codec.compress(dataSet[i].image, format, compressedImages[i]))
 			{
-				auto s0 = static_cast<double>(image0.bytes[pixel + channel]);
-				auto s1 = static_cast<double>(image1.bytes[pixel + channel]);
-				auto error = (s1 - s0) / 255.0;
-				m_squareErrorSum += error * error;
+				std::cerr << "Failed to compress image " << dataSet[i].name << std::endl;
+				compressedImages[i].bytes.clear();
 			}
 		}
+	});
 
-		m_sampleCount += image0.bytes.size();
+	std::vector<Results> results;
+	results.push_back(measureDecompression(m_settings, dataSet, compressedImages, format, 1));
+	if (m_settings.threadCount > 1)
+	{
+		results.push_back(measureDecompression(withoutHeatmaps(m_settings), dataSet, compressedImages, format, m_settings.threadCount));
 	}
 
-	double calculateError() const
+	return results;
+}
+
+std::vector<Benchmark::Results> Benchmark::runCacheStates(const DataSet& dataSet, CompressedFormat format)
+{
+	std::vector<Results> results;
+	for (auto state : { CacheState::Cold, CacheState::Warm })
 	{
-		return (m_sampleCount > 0 ? sqrt(m_squareErrorSum / m_sampleCount) : 0.0);
+		auto settings = results.empty() ? m_settings : withoutHeatmaps(m_settings);
+		settings.cacheState = state;
+		results.push_back(measure(m_codec, settings, dataSet, format, m_settings.threadCount));
 	}
 
-private:
-	double m_squareErrorSum = 0.0;
-	size_t m_sampleCount = 0;
-	const size_t m_relevantChannels;
-};
-} // namespace
+	return results;
+}
 
-Benchmark::Results Benchmark::run(const std::string& contentDir, CompressedFormat format)
+std::vector<Benchmark::Results> Benchmark::runScalingSweep(const DataSet& dataSet, CompressedFormat format)
 {
-	auto uncompressedImages = loadDataSet(contentDir);
+	std::vector<Results> results;
+	for (size_t threadCount = 1; ; threadCount *= 2)
+	{
+		threadCount = std::min(threadCount, m_settings.threadCount);
+		results.push_back(measure(m_codec, results.empty() ? m_settings : withoutHeatmaps(m_settings), dataSet, format, threadCount));
 
-	Results results;
-	results.hasErrors = false;
-	results.processedBytes = 0;
-	results.compressionError = 0.0f;
+		if (threadCount == m_settings.threadCount)
+		{
+			break;
+		}
+	}
 
-	std::vector<CompressedImage> compressedImages;
-	compressedImages.reserve(uncompressedImages.size());
+	return results;
+}
 
-	auto start = std::chrono::steady_clock::now();
-	for (const auto& uncompressed : uncompressedImages)
+std::vector<Benchmark::ThreadSplitGroup> Benchmark::runThreadSplits(const DataSet& dataSet, CompressedFormat format)
+{
+	std::vector<ThreadSplitGroup> groups;
+	auto runSplits = [&](const DataSet& images)
 	{
-		CompressedImage compressed;
-		if (m_codec.compress(uncompressed, format, compressed))
+		std::vector<Results> splits;
+		for (size_t threadCount = 1; ; threadCount *= 2)
 		{
-			results.processedBytes += uncompressed.bytes.size();
+			threadCount = std::min(threadCount, m_settings.threadCount);
+
+			auto settings = groups.empty() && splits.empty() ? m_settings : withoutHeatmaps(m_settings);
+			settings.codecThreadCount = std::max<size_t>(m_settings.threadCount / threadCount, 1);
+			splits.push_back(measure(m_codec, settings, images, format, threadCount));
+
+			if (threadCount == m_settings.threadCount)
+			{
+				break;
+			}
 		}
-		else
+
+		return splits;
+	};
+
+	groups.push_back({ "all images", runSplits(dataSet) });
+
+	// Groups are keyed by the side of a square image with at least as many pixels, rounded up to a power of two
+	std::map<size_t, std::vector<size_t>> bySize;
+	for (size_t i = 0, n = dataSet.size(); i < n; ++i)
+	{
+		size_t side = 4;
+		while (side * side < dataSet[i].image.width * dataSet[i].image.height)
 		{
-			std::cerr << "Failed to compress image" << std::endl;
-			results.hasErrors = true;
-			compressed.bytes.clear();
+			side *= 2;
 		}
+		bySize[side].push_back(i);
+	}
 
-		compressedImages.push_back(std::move(compressed));
+	if (bySize.size() < 2)
+	{
+		return groups;
 	}
-	auto end = std::chrono::steady_clock::now();
 
-	ErrorCalculator calculator(relevantChannels(format));
-	for (size_t i = 0, n = uncompressedImages.size(); i < n; ++i)
+	// One group is copied at a time, on top of the data set
+	for (const auto& entry : bySize)
 	{
-		const auto& uncompressed = uncompressedImages[i];
-		const auto& compressed = compressedImages[i];
+		DataSet images;
+		for (auto i : entry.second)
+		{
+			images.push_back(dataSet[i]);
+		}
+
+		auto side = std::to_string(entry.first);
+		groups.push_back({ "up to " + side + "x" + side, runSplits(images) });
+	}
+
+	return groups;
+}
 
-		if (compressed.bytes.empty())
+Benchmark::Results Benchmark::runSoak(const DataSet& dataSet, CompressedFormat format, double durationSeconds, std::vector<SoakSample>& samples)
+{
+	auto threadCount = std::max<size_t>(m_settings.threadCount, 1);
+	m_codec.setThreadCount(codecThreadBudget(m_settings, threadCount));
+
+	// Every round is a single timed pass, the first one doubles as the warmup
+	auto roundSettings = m_settings;
+	roundSettings.warmupRuns = 0;
+	roundSettings.repetitions = 1;
+
+	std::vector<CompressedImage> compressedImages(dataSet.size());
+	auto compress = [&](size_t i, size_t)
+	{
+		if (!m_codec.compress(dataSet[i].image, format, compressedImages[i]))
 		{
-			continue;
+			std::cerr << "Failed to compress image " << dataSet[i].name << std::endl;
+			compressedImages[i].bytes.clear();
+			return false;
 		}
 
-		UncompressedImage decompressed;
-		if (!genericDecompress(compressed, UncompressedFormat::RGBA8, decompressed))
+		return true;
+	};
+
+	Timings timings;
+	SystemMonitor monitor;
+	auto start = Clock::now();
+	do
+	{
+		TraceZone zone("soak round");
+		auto round = timePasses(roundSettings, dataSet, threadCount, "compress", compress);
+
+		size_t roundBytes = 0;
+		for (size_t i = 0, n = dataSet.size(); i < n; ++i)
 		{
-			std::cerr << "Failed to decompress image" << std::endl;
-			results.hasErrors = true;
+			roundBytes += round.failed[i] ? 0 : dataSet[i].image.bytes.size();
 		}
-		else if (uncompressed.bytes.size() != decompressed.bytes.size())
+
+		SoakSample sample;
+		sample.seconds = elapsedNanoseconds(start, Clock::now()) * 1e-9;
+		sample.roundSeconds = round.passNanoseconds.front() * 1e-9;
+		sample.throughputBytesPerSec = sample.roundSeconds > 0.0 ? roundBytes / sample.roundSeconds : 0.0;
+		sample.residentSetBytes = currentResidentSetBytes();
+		monitor.collect(sample);
+		samples.push_back(std::move(sample));
+
+		if (timings.passNanoseconds.empty())
 		{
-			std::cerr << "Image has a different size after the decompression" << std::endl;
-			results.hasErrors = true;
+			timings = std::move(round);
 		}
 		else
 		{
-			calculator.addSamples(uncompressed, decompressed);
+			appendTimings(timings, round);
 		}
-	}
+	} while (samples.back().seconds < durationSeconds);
 
-	results.elapsedSeconds = std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
-
-	auto throughput = static_cast<float>(results.processedBytes) / results.elapsedSeconds;
-	results.throughputBytesPerSec = static_cast<size_t>(throughput);
-
-	results.compressionError = calculator.calculateError();
+	auto results = makeResults(dataSet, timings, threadCount);
+	accumulateError(dataSet, compressedImages, timings, format, m_settings, results);
+	results.peakResidentBytes = residentBytes(dataSet, compressedImages, m_settings.metrics);
+	results.codecThreadCount = m_codec.threadCount();
 
 	return results;
 }
@@ -1,6 +1,16 @@
 #pragma once
 
+#include "block_errors.hpp"
+#include "cache_state.hpp"
 #include "codec.hpp"
+#include "dataset.hpp"
+#include "energy.hpp"
+#include "memory_stats.hpp"
+#include "metrics.hpp"
+#include "perf_counters.hpp"
+#include "placement.hpp"
+#include "soak.hpp"
+#include "statistics.hpp"
 
 #include <vector>
 #include <string>
@@ -8,19 +18,157 @@
 class Benchmark final
 {
 public:
+	struct Settings
+	{
+		size_t warmupRuns = 1;
+		size_t repetitions = 3;
+		size_t threadCount = 1;
+		// Threads inside every codec call, 0 splits the hardware threads between the threadCount
+		// concurrent images, or leaves the codec at its default when there is only one
+		size_t codecThreadCount = 0;
+		// Worker threads pinned to CPUs and images placed on the NUMA nodes of their workers
+		ThreadPlacement placement;
+		// Caches before every timed call. Evicting and warming up is left out of the pass times,
+		// energy covers the passes as a whole and isn't measured unless caches are left as loaded.
+		CacheState cacheState = CacheState::Loaded;
+
+		// Stream images through load, compress and verify stages instead of loading the whole data set,
+		// every pass decodes the PNG files again
+		bool pipelined = false;
+		size_t memoryBudgetBytes = size_t(1) << 30;
+
+		// Quality metrics computed in addition to RMSE
+		MetricSelection metrics;
+
+		// Per-block error outputs, the block decode is shared with the RMSE computation
+		BlockErrorOptions blockErrors;
+
+		// Count hardware events around every timed codec call
+		bool perfCounters = false;
+
+		// Record peak resident set and allocations of every timed codec call
+		bool memoryStats = false;
+
+		// Once a measurement has run this long, warmup passes included, the images being compressed are
+		// finished and the rest is skipped, their time is extrapolated. 0 runs without a budget.
+		double timeBudgetSeconds = 0.0;
+		// Print progress and an ETA of every measurement to stderr
+		bool progress = false;
+	};
+
+	struct ImageResults
+	{
+		std::string name;
+		size_t width;
+		size_t height;
+		Statistics elapsedNanoseconds;
+		double cyclesPerBlock;
+		BlockErrorReport blockErrors;
+		// Worst of the timed calls on this image
+		MemoryUsage memory;
+	};
+
+	// Latencies of a codec that was just constructed, measured in latency mode only
+	struct StartupLatency
+	{
+		bool available = false;
+		// No codec of the same kind was constructed before in this process, so one-time
+		// initialization of the backend and the runtimes it loads is part of the construction
+		bool firstInProcess = false;
+		double constructionSeconds = 0.0;
+		double firstCompressSeconds = 0.0;
+	};
+
+	// Pass time of a measurement that its time budget cut short, summed over the images from their timed
+	// calls and, for the images that weren't timed, from a fit of perImage + perPixel * pixels to the others
+	struct Extrapolation
+	{
+		bool applied = false;
+		size_t timedImages = 0;
+		size_t totalImages = 0;
+		double nanosecondsPerImage = 0.0;
+		double nanosecondsPerPixel = 0.0;
+	};
+
+	// 95% confidence intervals of a sampled estimate of the whole data set, see estimate()
+	struct ConfidenceInterval
+	{
+		bool available = false;
+		double secondsLow = 0.0;
+		double secondsHigh = 0.0;
+		double errorLow = 0.0;
+		double errorHigh = 0.0;
+	};
+
 	struct Results
 	{
 		bool hasErrors;
 		size_t processedBytes;
-		size_t elapsedSeconds;
+		double elapsedSeconds;
 		size_t throughputBytesPerSec;
 		double compressionError;
+		QualityMetrics quality;
+		size_t threadCount;
+		// Threads every codec call was allowed, 0 when left to the codec
+		size_t codecThreadCount;
+		size_t peakResidentBytes;
+		double nanosecondsPerBlock;
+
+		// Statistics of the whole data set compression time over all repetitions
+		Statistics passNanoseconds;
+		// Pipelined runs only: the pass from the first load to the last compress call, waits included
+		Statistics wallNanoseconds;
+		std::vector<ImageResults> images;
+
+		// Totals over all timed calls when Settings::perfCounters is set, and the blocks those calls processed
+		PerfCounterValues perfCounters;
+		uint64_t perfCounterBlocks;
+
+		// Highest peak of all images, allocations summed over one pass
+		MemoryUsage memory;
+
+		// RAPL energy of the timed passes, not available in pipelined runs or runs cut by a time budget
+		EnergyUsage energy;
+
+		Extrapolation extrapolation;
+
+		StartupLatency startup;
+
+		ConfidenceInterval interval;
 	};
 
 	Benchmark(Codec& codec) : m_codec(codec) {}
+	Benchmark(Codec& codec, const Settings& settings) : m_codec(codec), m_settings(settings) {}
 
 	Results run(const std::string& contentDir, CompressedFormat format);
+	Results run(const DataSet& dataSet, CompressedFormat format);
+
+	// Compresses the data set once and times decompression of the result,
+	// with one thread and, when Settings::threadCount is larger, with that many threads
+	std::vector<Results> runDecompression(const DataSet& dataSet, CompressedFormat format);
+
+	// Compresses the data set with cold caches and then with warm caches, whatever Settings::cacheState
+	std::vector<Results> runCacheStates(const DataSet& dataSet, CompressedFormat format);
+
+	// Compresses the data set with 1, 2, 4... up to Settings::threadCount threads
+	std::vector<Results> runScalingSweep(const DataSet& dataSet, CompressedFormat format);
+
+	// Results of one group of images for every split of the thread budget
+	struct ThreadSplitGroup
+	{
+		std::string name;
+		std::vector<Results> splits;
+	};
+
+	// Compresses the data set, and then every group of images of similar size, with 1, 2, 4... up to
+	// Settings::threadCount concurrent images, each given an equal share of Settings::threadCount threads
+	std::vector<ThreadSplitGroup> runThreadSplits(const DataSet& dataSet, CompressedFormat format);
+
+	// Compresses the data set round after round for durationSeconds, at least once, and adds a sample
+	// per round. The results cover all rounds as passes, the error is that of the last round.
+	Results runSoak(const DataSet& dataSet, CompressedFormat format, double durationSeconds, std::vector<SoakSample>& samples);
 
 private:
 	Codec& m_codec;
+	Settings m_settings;
 };
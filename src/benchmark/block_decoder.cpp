@@ -0,0 +1,173 @@
+#include "block_decoder.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+unsigned char roundToByte(float value)
+{
+	return static_cast<unsigned char>(value + 0.5f);
+}
+
+uint16_t readUint16(const unsigned char* bytes)
+{
+	return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t readUint32(const unsigned char* bytes)
+{
+	return static_cast<uint32_t>(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16)) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+// Endpoint channels in [0, 255] but not yet rounded, so that interpolation happens at full precision
+void decode565(uint16_t color, float rgb[3])
+{
+	rgb[0] = static_cast<float>((color >> 11) & 31) * (255.f / 31.f);
+	rgb[1] = static_cast<float>((color >> 5) & 63) * (255.f / 63.f);
+	rgb[2] = static_cast<float>(color & 31) * (255.f / 31.f);
+}
+
+// BC1 color block, also the second half of a BC3 block where the 3 color mode is never used
+void decodeColorBlock(const unsigned char* block, bool allowThreeColorMode, unsigned char pixels[64])
+{
+	auto color0 = readUint16(block);
+	auto color1 = readUint16(block + 2);
+	auto indices = readUint32(block + 4);
+
+	float endpoints[2][3];
+	decode565(color0, endpoints[0]);
+	decode565(color1, endpoints[1]);
+
+	unsigned char palette[4][4];
+	for (size_t channel = 0; channel < 3; ++channel)
+	{
+		auto e0 = endpoints[0][channel];
+		auto e1 = endpoints[1][channel];
+		palette[0][channel] = roundToByte(e0);
+		palette[1][channel] = roundToByte(e1);
+
+		if (!allowThreeColorMode || color0 > color1)
+		{
+			palette[2][channel] = roundToByte(e0 + (e1 - e0) / 3.f);
+			palette[3][channel] = roundToByte(e0 + (e1 - e0) * 2.f / 3.f);
+		}
+		else
+		{
+			palette[2][channel] = roundToByte((e0 + e1) * 0.5f);
+			palette[3][channel] = 0;
+		}
+	}
+
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	palette[3][3] = (allowThreeColorMode && color0 <= color1) ? 0 : 255;
+
+	for (size_t pixel = 0; pixel < 16; ++pixel)
+	{
+		std::memcpy(pixels + pixel * 4, palette[(indices >> (pixel * 2)) & 3], 4);
+	}
+}
+
+// BC4 block, also used for BC3 alpha and both BC5 channels
+void decodeSingleChannelBlock(const unsigned char* block, unsigned char pixels[64], size_t channel)
+{
+	auto e0 = static_cast<float>(block[0]);
+	auto e1 = static_cast<float>(block[1]);
+
+	unsigned char palette[8];
+	palette[0] = block[0];
+	palette[1] = block[1];
+	if (block[0] > block[1])
+	{
+		for (size_t i = 1; i < 7; ++i)
+		{
+			palette[i + 1] = roundToByte(e0 + (e1 - e0) * static_cast<float>(i) / 7.f);
+		}
+	}
+	else
+	{
+		for (size_t i = 1; i < 5; ++i)
+		{
+			palette[i + 1] = roundToByte(e0 + (e1 - e0) * static_cast<float>(i) / 5.f);
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	// 48 bits of 3-bit indices
+	uint64_t indices = 0;
+	for (size_t i = 0; i < 6; ++i)
+	{
+		indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+	}
+
+	for (size_t pixel = 0; pixel < 16; ++pixel)
+	{
+		pixels[pixel * 4 + channel] = palette[(indices >> (pixel * 3)) & 7];
+	}
+}
+} // namespace
+
+size_t blockSize(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1: return 8;
+	case CompressedFormat::BC4: return 8;
+	default: return 16;
+	}
+}
+
+bool hasBlockDecoder(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1:
+	case CompressedFormat::BC3:
+	case CompressedFormat::BC4:
+	case CompressedFormat::BC5:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void decodeBlock(CompressedFormat format, const unsigned char* block, unsigned char pixels[64])
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1:
+		decodeColorBlock(block, true, pixels);
+		break;
+
+	case CompressedFormat::BC3:
+		decodeColorBlock(block + 8, false, pixels);
+		decodeSingleChannelBlock(block, pixels, 3);
+		break;
+
+	case CompressedFormat::BC4:
+		// Same layout as DirectXTex decoding BC4_UNORM to R8G8B8A8
+		for (size_t pixel = 0; pixel < 16; ++pixel)
+		{
+			pixels[pixel * 4 + 1] = 0;
+			pixels[pixel * 4 + 2] = 0;
+			pixels[pixel * 4 + 3] = 255;
+		}
+		decodeSingleChannelBlock(block, pixels, 0);
+		break;
+
+	case CompressedFormat::BC5:
+		for (size_t pixel = 0; pixel < 16; ++pixel)
+		{
+			pixels[pixel * 4 + 2] = 0;
+			pixels[pixel * 4 + 3] = 255;
+		}
+		decodeSingleChannelBlock(block, pixels, 0);
+		decodeSingleChannelBlock(block + 8, pixels, 1);
+		break;
+
+	default:
+		std::memset(pixels, 0, 64);
+		break;
+	}
+}
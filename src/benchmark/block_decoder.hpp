@@ -0,0 +1,12 @@
+#pragma once
+
+#include "codec.hpp"
+
+size_t blockSize(CompressedFormat format);
+
+// Formats with a native decoder in decodeBlock, the others have to go through genericDecompress
+bool hasBlockDecoder(CompressedFormat format);
+
+// Decodes one 4x4 block into 16 row-major RGBA8 pixels.
+// Follows the DirectXTex reference decoder, which interpolates in float and rounds to nearest.
+void decodeBlock(CompressedFormat format, const unsigned char* block, unsigned char pixels[64]);
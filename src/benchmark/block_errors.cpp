@@ -0,0 +1,155 @@
+#include "block_errors.hpp"
+#include "block_decoder.hpp"
+#include "error_calculator.hpp"
+
+#include <png_utils.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+
+namespace
+{
+// Heatmap gray level per 8-bit level of block RMSE, blocks off by 64 levels or more are white
+const double HeatmapScale = 4.0;
+
+// The decoder the block errors were computed with, so that a crop shows the error it was ranked by
+bool decodeSingleBlock(const CompressedImage& compressed, size_t blockIndex, unsigned char pixels[64])
+{
+	auto size = blockSize(compressed.format);
+	auto begin = compressed.bytes.begin() + blockIndex * size;
+	if (hasBlockDecoder(compressed.format))
+	{
+		decodeBlock(compressed.format, &*begin, pixels);
+		return true;
+	}
+
+	CompressedImage block;
+	block.format = compressed.format;
+	block.width = 4;
+	block.height = 4;
+	block.bytes.assign(begin, begin + size);
+
+	UncompressedImage decoded;
+	if (!genericDecompress(block, UncompressedFormat::RGBA8, decoded) || decoded.bytes.size() < 64)
+	{
+		return false;
+	}
+
+	std::memcpy(pixels, decoded.bytes.data(), 64);
+	return true;
+}
+
+void writeHeatmap(const DataSetImage& image, const BlockErrorOptions& options, const std::vector<double>& blockRmse, size_t blocksX, size_t blocksY)
+{
+	std::vector<unsigned char> pixels(blocksX * blocksY * 4);
+	for (size_t i = 0, n = blockRmse.size(); i < n; ++i)
+	{
+		auto gray = static_cast<unsigned char>(std::min(255.0, std::round(blockRmse[i] * HeatmapScale)));
+		pixels[i * 4 + 0] = gray;
+		pixels[i * 4 + 1] = gray;
+		pixels[i * 4 + 2] = gray;
+		pixels[i * 4 + 3] = 255;
+	}
+
+	auto fileName = options.heatmapPrefix.empty() ? image.name : options.heatmapPrefix + "_" + image.name;
+	auto path = (std::filesystem::path(options.heatmapDir) / fileName).string();
+
+	std::error_code error;
+	std::filesystem::create_directories(options.heatmapDir, error);
+	if (!PngUtils::writePng(path.c_str(), PngUtils::Format::RGBA, blocksX, blocksY, pixels.data()))
+	{
+		std::cerr << "Failed to write heatmap " << path << std::endl;
+	}
+}
+} // namespace
+
+bool analyzeBlockErrors(
+	const DataSetImage& image,
+	const CompressedImage& compressed,
+	size_t relevantChannels,
+	const BlockErrorOptions& options,
+	size_t threadCount,
+	uint64_t& squaredErrorSum,
+	BlockErrorReport& report)
+{
+	std::vector<uint64_t> blockErrors;
+	if (!computeBlockErrors(image.image, compressed, relevantChannels, threadCount, squaredErrorSum, &blockErrors))
+	{
+		return false;
+	}
+
+	auto width = image.image.width;
+	auto height = image.image.height;
+	auto blocksX = (width + 3) / 4;
+	auto blocksY = (height + 3) / 4;
+
+	std::vector<double> blockRmse(blockErrors.size());
+	for (size_t by = 0; by < blocksY; ++by)
+	{
+		for (size_t bx = 0; bx < blocksX; ++bx)
+		{
+			auto samples = std::min<size_t>(4, width - bx * 4) * std::min<size_t>(4, height - by * 4) * relevantChannels;
+			auto index = by * blocksX + bx;
+			blockRmse[index] = std::sqrt(static_cast<double>(blockErrors[index]) / samples);
+		}
+	}
+
+	if (options.histogram)
+	{
+		for (auto rmse : blockRmse)
+		{
+			size_t bucket = 0;
+			if (rmse >= 1.0)
+			{
+				bucket = std::min(BlockErrorHistogramSize - 1, 1 + static_cast<size_t>(std::log2(rmse)));
+			}
+			++report.histogram[bucket];
+		}
+	}
+
+	if (!options.heatmapDir.empty())
+	{
+		writeHeatmap(image, options, blockRmse, blocksX, blocksY);
+	}
+
+	if (options.worstBlockCount > 0)
+	{
+		std::vector<size_t> order(blockRmse.size());
+		std::iota(std::begin(order), std::end(order), size_t(0));
+
+		auto count = std::min(options.worstBlockCount, order.size());
+		std::partial_sort(std::begin(order), std::begin(order) + count, std::end(order),
+			[&](size_t a, size_t b) { return blockRmse[a] > blockRmse[b]; });
+
+		auto pitch = width * 4;
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto index = order[i];
+
+			WorstBlock block = {};
+			block.x = (index % blocksX) * 4;
+			block.y = (index / blocksX) * 4;
+			block.error = blockRmse[index];
+
+			auto columns = std::min<size_t>(4, width - block.x);
+			auto rows = std::min<size_t>(4, height - block.y);
+			for (size_t row = 0; row < rows; ++row)
+			{
+				std::memcpy(block.source + row * 16, image.image.bytes.data() + (block.y + row) * pitch + block.x * 4, columns * 4);
+			}
+
+			if (!decodeSingleBlock(compressed, index, block.decoded))
+			{
+				return false;
+			}
+
+			report.worstBlocks.push_back(block);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "dataset.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BlockErrorOptions
+{
+	// Grayscale heatmaps with one pixel per 4x4 block are written here when not empty
+	std::string heatmapDir;
+	// Prepended to heatmap file names, so that several configurations can share a directory
+	std::string heatmapPrefix;
+	size_t worstBlockCount = 0;
+	bool histogram = false;
+
+	bool enabled() const { return !heatmapDir.empty() || worstBlockCount > 0 || histogram; }
+};
+
+struct WorstBlock
+{
+	size_t x;
+	size_t y;
+	// Block RMSE in 8-bit levels
+	double error;
+	unsigned char source[64];
+	unsigned char decoded[64];
+};
+
+// Histogram bucket i counts blocks with RMSE in [2^(i-1), 2^i) 8-bit levels, bucket 0 counts RMSE below 1
+const size_t BlockErrorHistogramSize = 9;
+
+struct BlockErrorReport
+{
+	size_t histogram[BlockErrorHistogramSize] = {};
+	std::vector<WorstBlock> worstBlocks;
+};
+
+// Runs the fused block error pass over one image and derives the outputs selected in options.
+// Returns false when the image can't be decoded.
+bool analyzeBlockErrors(
+	const DataSetImage& image,
+	const CompressedImage& compressed,
+	size_t relevantChannels,
+	const BlockErrorOptions& options,
+	size_t threadCount,
+	uint64_t& squaredErrorSum,
+	BlockErrorReport& report);
@@ -0,0 +1,159 @@
+#include "cache_state.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <filesystem>
+#include <fstream>
+#endif
+
+namespace
+{
+// Larger than the last level cache of most desktop CPUs
+const size_t DefaultCacheBytes = size_t(32) << 20;
+const size_t CacheLineBytes = 64;
+
+// Reads of the eviction buffer end up here so that they aren't optimized away
+volatile unsigned char g_sink = 0;
+
+#if defined(_WIN32)
+size_t queryLastLevelCacheBytes()
+{
+	DWORD length = 0;
+	GetLogicalProcessorInformation(nullptr, &length);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (infos.empty() || !GetLogicalProcessorInformation(infos.data(), &length))
+	{
+		return 0;
+	}
+
+	BYTE level = 0;
+	size_t bytes = 0;
+	for (const auto& info : infos)
+	{
+		if (info.Relationship == RelationCache && info.Cache.Type != CacheInstruction && info.Cache.Level >= level)
+		{
+			bytes = info.Cache.Level > level ? info.Cache.Size : std::max<size_t>(bytes, info.Cache.Size);
+			level = info.Cache.Level;
+		}
+	}
+
+	return bytes;
+}
+#elif defined(__linux__)
+// Sizes are given like 32768K
+size_t parseCacheSize(const std::string& str)
+{
+	size_t pos = 0;
+	auto value = std::stoull(str, &pos);
+	auto suffix = pos < str.size() ? str[pos] : ' ';
+	return static_cast<size_t>(value) * (suffix == 'K' ? 1024 : suffix == 'M' ? 1024 * 1024 : 1);
+}
+
+size_t queryLastLevelCacheBytes()
+{
+	std::error_code error;
+	int level = 0;
+	size_t bytes = 0;
+	for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/cpu0/cache", error))
+	{
+		if (entry.path().filename().string().compare(0, 5, "index") != 0)
+		{
+			continue;
+		}
+
+		std::ifstream typeFile(entry.path() / "type");
+		std::ifstream levelFile(entry.path() / "level");
+		std::ifstream sizeFile(entry.path() / "size");
+		std::string type, size;
+		int cacheLevel = 0;
+		if (!(typeFile >> type) || !(levelFile >> cacheLevel) || !(sizeFile >> size) || type == "Instruction" || cacheLevel < level)
+		{
+			continue;
+		}
+
+		try
+		{
+			auto cacheBytes = parseCacheSize(size);
+			bytes = cacheLevel > level ? cacheBytes : std::max(bytes, cacheBytes);
+			level = cacheLevel;
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	return bytes;
+}
+#else
+size_t queryLastLevelCacheBytes()
+{
+	return 0;
+}
+#endif
+} // namespace
+
+bool parseCacheState(const std::string& str, CacheState& state)
+{
+	if (str == "loaded")
+	{
+		state = CacheState::Loaded;
+		return true;
+	}
+	if (str == "cold")
+	{
+		state = CacheState::Cold;
+		return true;
+	}
+	if (str == "warm")
+	{
+		state = CacheState::Warm;
+		return true;
+	}
+
+	return false;
+}
+
+const char* toString(CacheState state)
+{
+	switch (state)
+	{
+	case CacheState::Loaded: return "loaded";
+	case CacheState::Cold: return "cold";
+	case CacheState::Warm: return "warm";
+	default: return "unknown";
+	}
+}
+
+size_t lastLevelCacheBytes()
+{
+	static const size_t bytes = []()
+	{
+		auto queried = queryLastLevelCacheBytes();
+		return queried > 0 ? queried : DefaultCacheBytes;
+	}();
+
+	return bytes;
+}
+
+CacheEvictor::CacheEvictor() : m_size(2 * lastLevelCacheBytes()), m_buffer(new unsigned char[m_size])
+{
+	// Untouched pages would all map the same zero page, which takes no room in the caches
+	std::memset(m_buffer.get(), 1, m_size);
+}
+
+void CacheEvictor::evict() const
+{
+	unsigned char sum = 0;
+	for (size_t i = 0; i < m_size; i += CacheLineBytes)
+	{
+		sum += m_buffer[i];
+	}
+
+	g_sink = g_sink + sum;
+}
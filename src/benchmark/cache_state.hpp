@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+enum class CacheState
+{
+	// Images as loadDataSet left them, the last ones decoded may still be cached
+	Loaded,
+	// Caches are evicted before every timed call, as for freshly read data
+	Cold,
+	// Every timed call directly follows an untimed call on the same image
+	Warm,
+};
+
+bool parseCacheState(const std::string& str, CacheState& state);
+const char* toString(CacheState state);
+
+// Size of the largest data cache of the CPU, a conservative default when it can't be queried
+size_t lastLevelCacheBytes();
+
+// Streams through a buffer of twice the last level cache, which leaves none of the
+// data touched before in any cache level. Several threads may evict at the same time.
+class CacheEvictor final
+{
+public:
+	CacheEvictor();
+
+	void evict() const;
+
+private:
+	size_t m_size;
+	std::unique_ptr<unsigned char[]> m_buffer;
+};
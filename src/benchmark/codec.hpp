@@ -48,6 +48,10 @@ public:
 	CompressionQuality quality() const { return m_quality; }
 	void setQuality(CompressionQuality value) { m_quality = value; }
 
+	// Threads the backend may use inside one compress call, 0 leaves it to the backend
+	size_t threadCount() const { return m_threadCount; }
+	void setThreadCount(size_t value) { m_threadCount = value; }
+
 	bool compress(const UncompressedImage& input, CompressedFormat format, CompressedImage& output);
 
 private:
@@ -55,6 +59,7 @@ private:
 
 private:
 	CompressionQuality m_quality = CompressionQuality::Medium;
+	size_t m_threadCount = 0;
 };
 
 bool genericDecompress(const CompressedImage& input, UncompressedFormat format, UncompressedImage& output);
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <Compressonator.h>
 
+#include <algorithm>
 #include <iostream>
 
 namespace
@@ -25,7 +26,9 @@ bool CompressonatorCodec::doCompress(const UncompressedImage& input, CompressedF
 {
 	CMP_CompressOptions options = { 0 };
 	options.dwSize = sizeof(options);
-	options.bDisableMultiThreading = 0;
+	// BC7 is the only encoder with a thread count, the others either use all cores or one
+	options.bDisableMultiThreading = threadCount() == 1;
+	options.dwnumThreads = static_cast<CMP_DWORD>(std::min<size_t>(threadCount(), 128));
 
 	switch (quality())
 	{
@@ -0,0 +1,277 @@
+#include "configuration.hpp"
+#include "compressonator_codec.hpp"
+#include "nvtt_codec.hpp"
+#include "directxtex_codec.hpp"
+
+#include <algorithm>
+
+bool operator==(const Configuration& lhs, const Configuration& rhs)
+{
+	return lhs.codec == rhs.codec &&
+		lhs.format == rhs.format &&
+		lhs.quality == rhs.quality &&
+		lhs.useGPU == rhs.useGPU &&
+		lhs.bc7Quick == rhs.bc7Quick &&
+		lhs.bc7Use3Subsets == rhs.bc7Use3Subsets;
+}
+
+bool parseFormat(const std::string& str, CompressedFormat& format)
+{
+	if (str == "bc1")
+	{
+		format = CompressedFormat::BC1;
+		return true;
+	}
+	else if (str == "bc3")
+	{
+		format = CompressedFormat::BC3;
+		return true;
+	}
+	else if (str == "bc4")
+	{
+		format = CompressedFormat::BC4;
+		return true;
+	}
+	else if (str == "bc5")
+	{
+		format = CompressedFormat::BC5;
+		return true;
+	}
+	else if (str == "bc6")
+	{
+		format = CompressedFormat::BC6;
+		return true;
+	}
+	else if (str == "bc7")
+	{
+		format = CompressedFormat::BC7;
+		return true;
+	}
+
+	return false;
+}
+
+bool parseCodec(const std::string& str, CodecType& codec)
+{
+	if (str == "compressonator")
+	{
+		codec = CodecType::Compressonator;
+		return true;
+	}
+	else if (str == "nvtt")
+	{
+		codec = CodecType::NVTT;
+		return true;
+	}
+	else if (str == "directxtex")
+	{
+		codec = CodecType::DirectXTex;
+		return true;
+	}
+
+	return false;
+}
+
+bool parseQuality(const std::string& str, CompressionQuality& quality)
+{
+	if (str == "low")
+	{
+		quality = CompressionQuality::Low;
+		return true;
+	}
+	else if (str == "medium")
+	{
+		quality = CompressionQuality::Medium;
+		return true;
+	}
+	else if (str == "high")
+	{
+		quality = CompressionQuality::High;
+		return true;
+	}
+
+	return false;
+}
+
+const char* toString(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1: return "bc1";
+	case CompressedFormat::BC3: return "bc3";
+	case CompressedFormat::BC4: return "bc4";
+	case CompressedFormat::BC5: return "bc5";
+	case CompressedFormat::BC6: return "bc6";
+	case CompressedFormat::BC7: return "bc7";
+	default: return "unknown";
+	}
+}
+
+size_t relevantChannels(CompressedFormat format)
+{
+	switch (format)
+	{
+	case CompressedFormat::BC1: return 3;
+	case CompressedFormat::BC3: return 3;
+	case CompressedFormat::BC4: return 1;
+	case CompressedFormat::BC5: return 2;
+	case CompressedFormat::BC6: return 3;
+	case CompressedFormat::BC7: return 3;
+	default: return 4;
+	}
+}
+
+const char* toString(CodecType codec)
+{
+	switch (codec)
+	{
+	case CodecType::Compressonator: return "compressonator";
+	case CodecType::NVTT: return "nvtt";
+	case CodecType::DirectXTex: return "directxtex";
+	default: return "unknown";
+	}
+}
+
+const char* toString(CompressionQuality quality)
+{
+	switch (quality)
+	{
+	case CompressionQuality::Low: return "low";
+	case CompressionQuality::Medium: return "medium";
+	case CompressionQuality::High: return "high";
+	default: return "unknown";
+	}
+}
+
+std::string describe(const Configuration& config)
+{
+	std::string result = toString(config.format);
+	result += " ";
+	result += toString(config.codec);
+
+	if (config.codec != CodecType::DirectXTex)
+	{
+		result += " ";
+		result += toString(config.quality);
+	}
+
+	if (config.useGPU)
+	{
+		result += " gpu";
+	}
+
+	if (config.bc7Quick)
+	{
+		result += " bc7quick";
+	}
+
+	if (config.bc7Use3Subsets)
+	{
+		result += " bc7use3subsets";
+	}
+
+	return result;
+}
+
+Configuration normalize(Configuration config)
+{
+	switch (config.codec)
+	{
+	case CodecType::Compressonator:
+		config.useGPU = false;
+		config.bc7Quick = false;
+		config.bc7Use3Subsets = false;
+		break;
+
+	case CodecType::NVTT:
+		config.bc7Quick = false;
+		config.bc7Use3Subsets = false;
+		break;
+
+	case CodecType::DirectXTex:
+		// DirectXTex has no quality knob and uses the GPU only for BC6 and BC7
+		config.quality = CompressionQuality::Medium;
+		if (config.format != CompressedFormat::BC6 && config.format != CompressedFormat::BC7)
+		{
+			config.useGPU = false;
+		}
+		if (config.format != CompressedFormat::BC7)
+		{
+			config.bc7Quick = false;
+			config.bc7Use3Subsets = false;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return config;
+}
+
+std::vector<Configuration> expandMatrix(const Matrix& matrix)
+{
+	std::vector<Configuration> result;
+	for (auto format : matrix.formats)
+	{
+		for (auto codec : matrix.codecs)
+		{
+			for (auto quality : matrix.qualities)
+			{
+				for (auto useGPU : matrix.useGPU)
+				{
+					for (auto bc7Quick : matrix.bc7Quick)
+					{
+						for (auto bc7Use3Subsets : matrix.bc7Use3Subsets)
+						{
+							auto config = normalize({ codec, format, quality, useGPU, bc7Quick, bc7Use3Subsets });
+							if (std::find(std::begin(result), std::end(result), config) == std::end(result))
+							{
+								result.push_back(config);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+std::unique_ptr<Codec> makeCodec(const Configuration& config)
+{
+	std::unique_ptr<Codec> result;
+	switch (config.codec)
+	{
+	case CodecType::Compressonator:
+		result = std::make_unique<CompressonatorCodec>();
+		break;
+
+	case CodecType::NVTT:
+	{
+		auto codec = std::make_unique<NvttCodec>();
+		codec->setCudaEnabled(config.useGPU);
+		result = std::move(codec);
+		break;
+	}
+
+	case CodecType::DirectXTex:
+	{
+		auto mode = config.useGPU ?
+			DirectXTexCodec::Mode::CPU_GPU :
+			DirectXTexCodec::Mode::CPU_ONLY;
+		auto codec = std::make_unique<DirectXTexCodec>(mode);
+		codec->setBC7Quick(config.bc7Quick);
+		codec->setBC7Use3Subsets(config.bc7Use3Subsets);
+		result = std::move(codec);
+		break;
+	}
+
+	default:
+		return nullptr;
+	}
+
+	result->setQuality(config.quality);
+	return result;
+}
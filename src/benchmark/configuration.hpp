@@ -0,0 +1,59 @@
+#pragma once
+
+#include "codec.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class CodecType
+{
+	Compressonator,
+	NVTT,
+	DirectXTex,
+};
+
+// One point of the benchmark matrix
+struct Configuration
+{
+	CodecType codec;
+	CompressedFormat format;
+	CompressionQuality quality;
+	bool useGPU;
+	bool bc7Quick;
+	bool bc7Use3Subsets;
+};
+
+bool operator==(const Configuration& lhs, const Configuration& rhs);
+
+bool parseFormat(const std::string& str, CompressedFormat& format);
+bool parseCodec(const std::string& str, CodecType& codec);
+bool parseQuality(const std::string& str, CompressionQuality& quality);
+
+const char* toString(CompressedFormat format);
+const char* toString(CodecType codec);
+const char* toString(CompressionQuality quality);
+
+// Channels a format stores and that count towards its error, e.g. only red for BC4
+size_t relevantChannels(CompressedFormat format);
+
+// Human readable one line summary, e.g. "bc7 directxtex medium gpu bc7quick"
+std::string describe(const Configuration& config);
+
+// Clears the options a backend ignores for the given format, so that equivalent configurations compare equal
+Configuration normalize(Configuration config);
+
+struct Matrix
+{
+	std::vector<CodecType> codecs;
+	std::vector<CompressedFormat> formats;
+	std::vector<CompressionQuality> qualities;
+	std::vector<bool> useGPU;
+	std::vector<bool> bc7Quick;
+	std::vector<bool> bc7Use3Subsets;
+};
+
+// Cartesian product of the matrix axes without configurations that differ only in ignored options
+std::vector<Configuration> expandMatrix(const Matrix& matrix);
+
+std::unique_ptr<Codec> makeCodec(const Configuration& config);
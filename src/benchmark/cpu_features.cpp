@@ -0,0 +1,61 @@
+#include "cpu_features.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace
+{
+void cpuid(int leaf, int subleaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex(reinterpret_cast<int*>(registers), leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+#if !defined(_MSC_VER)
+__attribute__((target("xsave")))
+#endif
+unsigned long long readXCR0()
+{
+	return _xgetbv(0);
+}
+
+bool detectAVX2()
+{
+	unsigned int registers[4];
+	cpuid(0, 0, registers);
+	if (registers[0] < 7)
+	{
+		return false;
+	}
+
+	cpuid(1, 0, registers);
+	auto osxsave = (registers[2] & (1u << 27)) != 0;
+	auto avx = (registers[2] & (1u << 28)) != 0;
+	if (!osxsave || !avx)
+	{
+		return false;
+	}
+
+	// XMM and YMM state must be enabled by the OS
+	if ((readXCR0() & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	cpuid(7, 0, registers);
+	return (registers[1] & (1u << 5)) != 0;
+}
+} // namespace
+
+bool cpuHasAVX2()
+{
+	static const bool result = detectAVX2();
+	return result;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// MSVC allows intrinsics of any instruction set in any function,
+// GCC and Clang need the target enabled per function
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Checks both the CPU and the OS support for saving the AVX state
+bool cpuHasAVX2();
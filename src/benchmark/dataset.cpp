@@ -0,0 +1,97 @@
+#include "dataset.hpp"
+#include "trace.hpp"
+
+#include <png_utils.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+bool endsWith(std::string const& str, std::string const& ending)
+{
+	if (str.length() >= ending.length())
+	{
+		return str.compare(str.length() - ending.length(), ending.length(), ending) == 0;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+UncompressedImage makeImageFromPngReadback(const PngUtils::Readback& readback)
+{
+	UncompressedImage image;
+	image.format = UncompressedFormat::RGBA8;
+	image.width = readback.width;
+	image.height = readback.height;
+
+	auto size = image.width * image.height * 4;
+	image.bytes.reserve(size);
+
+	auto begin = readback.data.get();
+	auto end = begin + size;
+	std::copy(begin, end, std::back_inserter(image.bytes));
+
+	return image;
+}
+} // namespace
+
+std::vector<std::string> listDataSet(const std::string& dir)
+{
+	std::vector<std::string> paths;
+	for (const auto& entry : std::filesystem::directory_iterator(dir))
+	{
+		const auto& path = entry.path().string();
+		if (endsWith(path, ".png"))
+		{
+			paths.push_back(path);
+		}
+	}
+
+	std::sort(std::begin(paths), std::end(paths));
+	return paths;
+}
+
+bool loadImage(const std::string& path, DataSetImage& image)
+{
+	PngUtils::Readback readback;
+	{
+		TraceZone zone("readPng", path);
+		readback = PngUtils::readPng(path.c_str());
+	}
+
+	if (readback.data == nullptr)
+	{
+		std::cerr << "Failed to load image" << path << std::endl;
+		return false;
+	}
+	else if (readback.format != PngUtils::Format::RGBA)
+	{
+		std::cerr << "Image has unsupported format " << path << std::endl;
+		return false;
+	}
+
+	image.name = std::filesystem::path(path).filename().string();
+	image.image = makeImageFromPngReadback(readback);
+	return true;
+}
+
+DataSet loadDataSet(const std::string& dir)
+{
+	TraceZone zone("load data set", dir);
+
+	DataSet result;
+	for (const auto& path : listDataSet(dir))
+	{
+		DataSetImage image;
+		if (loadImage(path, image))
+		{
+			result.push_back(std::move(image));
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "codec.hpp"
+
+#include <string>
+#include <vector>
+
+struct DataSetImage
+{
+	std::string name;
+	UncompressedImage image;
+};
+
+using DataSet = std::vector<DataSetImage>;
+
+// Paths of all PNG files in a directory, sorted by name so runs are reproducible
+std::vector<std::string> listDataSet(const std::string& dir);
+
+bool loadImage(const std::string& path, DataSetImage& image);
+
+DataSet loadDataSet(const std::string& dir);
@@ -43,7 +43,8 @@ bool decompressImpl(const CompressedImage& input, UncompressedFormat format, Unc
 	output.format = UncompressedFormat::RGBA8;
 	output.width = input.width;
 	output.height = input.height;
-	output.bytes = std::vector<unsigned char>(outImage.pixels, outImage.pixels + outImage.slicePitch);
+	// Copies into the existing storage of output, a caller that passes the same image again reuses it
+	output.bytes.assign(outImage.pixels, outImage.pixels + outImage.slicePitch);
 
 	return true;
 }
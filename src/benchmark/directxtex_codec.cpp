@@ -3,8 +3,10 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <DirectXTex.h>
+#include <omp.h>
 
 #include <iostream>
+#include <mutex>
 
 namespace
 {
@@ -61,12 +63,14 @@ public:
 	void setBC7Quick(bool value) { m_bc7Quick = value; }
 	void setBC7Use3Subsets(bool value) { m_bc7Use3Subsets = value; }
 
-	bool compress(const UncompressedImage& input, CompressedFormat format, CompressedImage& output);
+	bool compress(const UncompressedImage& input, CompressedFormat format, size_t threadCount, CompressedImage& output);
 
 private:
 	Mode m_mode;
 	Microsoft::WRL::ComPtr<ID3D11Device> m_device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_deviceContext;
+	// The immediate context is not thread safe, GPU compression requests from concurrent images are serialized
+	std::mutex m_deviceMutex;
 	bool m_bc7Quick = false;
 	bool m_bc7Use3Subsets = false;
 };
@@ -101,7 +105,7 @@ DirectXTexCodec::Impl::Impl(Mode mode)
 	}
 }
 
-bool DirectXTexCodec::Impl::compress(const UncompressedImage& input, CompressedFormat format, CompressedImage& output)
+bool DirectXTexCodec::Impl::compress(const UncompressedImage& input, CompressedFormat format, size_t threadCount, CompressedImage& output)
 {
 	DirectX::Image inImage;
 	inImage.width = input.width;
@@ -113,7 +117,13 @@ bool DirectXTexCodec::Impl::compress(const UncompressedImage& input, CompressedF
 
 	DirectX::ScratchImage outImages;
 
-	DWORD flags = DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_UNIFORM;
+	DWORD flags = DirectX::TEX_COMPRESS_UNIFORM;
+	if (threadCount != 1)
+	{
+		// The parallel compressor runs an OpenMP team, its size is a setting of the calling thread
+		flags |= DirectX::TEX_COMPRESS_PARALLEL;
+		omp_set_num_threads(static_cast<int>(threadCount > 0 ? threadCount : omp_get_num_procs()));
+	}
 	if (m_bc7Quick)
 	{
 		flags |= DirectX::TEX_COMPRESS_BC7_QUICK;
@@ -126,6 +136,7 @@ bool DirectXTexCodec::Impl::compress(const UncompressedImage& input, CompressedF
 	HRESULT hr;
 	if (m_mode == Mode::CPU_GPU && (format == CompressedFormat::BC6 || format == CompressedFormat::BC7))
 	{
+		std::lock_guard<std::mutex> lock(m_deviceMutex);
 		hr = DirectX::Compress(
 			m_device.Get(),
 			inImage, translateFormat(format),
@@ -175,5 +186,5 @@ void DirectXTexCodec::setBC7Use3Subsets(bool value)
 
 bool DirectXTexCodec::doCompress(const UncompressedImage& input, CompressedFormat format, CompressedImage& output)
 {
-	return m_impl->compress(input, format, output);
+	return m_impl->compress(input, format, threadCount(), output);
 }
@@ -0,0 +1,194 @@
+#include "energy.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+#if defined(__linux__)
+#include <filesystem>
+#endif
+
+namespace
+{
+bool readCounter(const std::string& path, uint64_t& value)
+{
+	std::ifstream in(path);
+	return static_cast<bool>(in >> value);
+}
+
+std::string readName(const std::string& path)
+{
+	std::ifstream in(path);
+	std::string name;
+	in >> name;
+	return name;
+}
+
+// Several samples per wrap of the fastest counter, zones without a power limit are assumed to wrap no faster
+const size_t SamplesPerWrap = 8;
+const std::chrono::milliseconds MinSampleInterval(10);
+const std::chrono::milliseconds MaxSampleInterval(1000);
+
+struct DomainInfo
+{
+	std::string counterPath;
+	bool dram;
+	uint64_t range;
+	// Microjoules over microwatts, 0 without a readable power limit
+	double wrapSeconds;
+};
+
+// Zones named package-N and their dram subzones, core and uncore are parts of the package and
+// psys covers the whole platform, counting those would count energy twice
+std::vector<DomainInfo> findDomains()
+{
+	std::vector<DomainInfo> domains;
+
+#if defined(__linux__)
+	// Every zone and subzone has an entry of its own at the top level
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator("/sys/class/powercap", error))
+	{
+		// The MMIO interface of some laptops reports the same package again
+		if (entry.path().filename().string().compare(0, 15, "intel-rapl-mmio") == 0)
+		{
+			continue;
+		}
+
+		auto dir = entry.path().string();
+		auto name = readName(dir + "/name");
+		auto isPackage = name.compare(0, 8, "package-") == 0;
+		if (!isPackage && name != "dram")
+		{
+			continue;
+		}
+
+		DomainInfo domain;
+		domain.counterPath = dir + "/energy_uj";
+		domain.dram = !isPackage;
+		domain.wrapSeconds = 0.0;
+
+		// Recent kernels make the counters readable by root only
+		uint64_t value;
+		if (readCounter(domain.counterPath, value) && readCounter(dir + "/max_energy_range_uj", domain.range))
+		{
+			uint64_t powerLimit;
+			if (readCounter(dir + "/constraint_0_power_limit_uw", powerLimit) && powerLimit > 0)
+			{
+				domain.wrapSeconds = static_cast<double>(domain.range) / powerLimit;
+			}
+			domains.push_back(domain);
+		}
+	}
+#endif
+
+	return domains;
+}
+
+const std::vector<DomainInfo>& domainInfos()
+{
+	static const auto domains = findDomains();
+	return domains;
+}
+} // namespace
+
+double EnergyUsage::joulesPerMegabyte(size_t bytesPerPass) const
+{
+	auto megabytes = static_cast<double>(bytesPerPass) * passes / (1024.0 * 1024.0);
+	return megabytes > 0.0 ? joules() / megabytes : 0.0;
+}
+
+EnergyMeter::EnergyMeter()
+	: m_interval(MaxSampleInterval)
+{
+	for (const auto& info : domainInfos())
+	{
+		m_domains.push_back({ info.counterPath, info.dram, info.range, 0 });
+		if (info.wrapSeconds > 0.0)
+		{
+			auto interval = std::chrono::milliseconds(static_cast<int64_t>(info.wrapSeconds * 1000.0 / SamplesPerWrap));
+			m_interval = std::max(MinSampleInterval, std::min(m_interval, interval));
+		}
+	}
+}
+
+EnergyMeter::~EnergyMeter()
+{
+	stopSampling();
+}
+
+void EnergyMeter::start()
+{
+	stopSampling();
+
+	m_packageJoules = 0.0;
+	m_dramJoules = 0.0;
+	for (auto& domain : m_domains)
+	{
+		readCounter(domain.counterPath, domain.last);
+	}
+	m_start = Clock::now();
+
+	if (!isAvailable())
+	{
+		return;
+	}
+
+	m_stopping = false;
+	m_sampler = std::thread([this]()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stopRequested.wait_for(lock, m_interval, [this]() { return m_stopping; }))
+		{
+			sample();
+		}
+	});
+}
+
+void EnergyMeter::stopSampling()
+{
+	if (!m_sampler.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_stopRequested.notify_all();
+	m_sampler.join();
+}
+
+void EnergyMeter::sample()
+{
+	for (auto& domain : m_domains)
+	{
+		uint64_t value;
+		if (!readCounter(domain.counterPath, value))
+		{
+			continue;
+		}
+
+		// A counter below its previous value went past max_energy_range_uj once and restarted at 0
+		auto microjoules = value >= domain.last ? value - domain.last : domain.range - domain.last + 1 + value;
+		(domain.dram ? m_dramJoules : m_packageJoules) += microjoules * 1e-6;
+		domain.last = value;
+	}
+}
+
+void EnergyMeter::stop(EnergyUsage& usage, size_t passes)
+{
+	stopSampling();
+	sample();
+
+	usage.available = isAvailable();
+	usage.passes = passes;
+	usage.packageJoules = m_packageJoules;
+	usage.dramJoules = m_dramJoules;
+	usage.seconds = elapsedNanoseconds(m_start, Clock::now()) * 1e-9;
+	usage.hasDram = false;
+	for (const auto& domain : m_domains)
+	{
+		usage.hasDram = usage.hasDram || domain.dram;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "timing.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Energy of all sockets over the timed passes of a measurement
+struct EnergyUsage
+{
+	bool available = false;
+	bool hasDram = false;
+	size_t passes = 0;
+	double packageJoules = 0.0;
+	double dramJoules = 0.0;
+	double seconds = 0.0;
+
+	double joules() const { return packageJoules + dramJoules; }
+	double averageWatts() const { return seconds > 0.0 ? joules() / seconds : 0.0; }
+	// Per MB of input, bytesPerPass being the input of one pass
+	double joulesPerMegabyte(size_t bytesPerPass) const;
+};
+
+// Package and DRAM energy counters of RAPL, read from /sys/class/powercap. The counters wrap
+// around after max_energy_range_uj, which can take only seconds at the power limit of a large
+// package, so between start() and stop() a thread samples them several times per wrap at that limit.
+// Without readable counters, e.g. off Linux, nothing is measured.
+class EnergyMeter final
+{
+public:
+	EnergyMeter();
+	~EnergyMeter();
+
+	EnergyMeter(const EnergyMeter&) = delete;
+	EnergyMeter& operator=(const EnergyMeter&) = delete;
+
+	bool isAvailable() const { return !m_domains.empty(); }
+
+	void start();
+	void stop(EnergyUsage& usage, size_t passes);
+
+private:
+	struct Domain
+	{
+		std::string counterPath;
+		bool dram;
+		uint64_t range;
+		uint64_t last;
+	};
+
+	// Adds the energy used since the previous sample
+	void sample();
+	void stopSampling();
+
+	std::vector<Domain> m_domains;
+	std::chrono::milliseconds m_interval;
+	Clock::time_point m_start;
+	double m_packageJoules = 0.0;
+	double m_dramJoules = 0.0;
+
+	std::thread m_sampler;
+	std::mutex m_mutex;
+	std::condition_variable m_stopRequested;
+	bool m_stopping = false;
+};
@@ -0,0 +1,292 @@
+#include "error_calculator.hpp"
+#include "block_decoder.hpp"
+#include "cpu_features.hpp"
+#include "parallel.hpp"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// Pixels per thread below which spawning threads costs more than it saves
+const size_t MinPixelsPerThread = 1 << 18;
+
+// 32-bit lanes are flushed into 64-bit accumulators before they can overflow:
+// one iteration adds at most 2 * 2 * 255^2 to a lane
+const size_t FlushInterval = 4096;
+
+uint32_t channelMask(size_t relevantChannels)
+{
+	return relevantChannels >= 4 ? 0xFFFFFFFFu : (1u << (relevantChannels * 8)) - 1;
+}
+
+uint64_t sumSquaredDifferencesScalar(const unsigned char* pixels0, const unsigned char* pixels1, size_t pixelCount, size_t relevantChannels)
+{
+	uint64_t sum = 0;
+	for (size_t pixel = 0; pixel < pixelCount; ++pixel)
+	{
+		for (size_t channel = 0; channel < relevantChannels; ++channel)
+		{
+			auto error = static_cast<int>(pixels0[pixel * 4 + channel]) - static_cast<int>(pixels1[pixel * 4 + channel]);
+			sum += static_cast<uint64_t>(error * error);
+		}
+	}
+
+	return sum;
+}
+
+__m128i squaredDifferences(__m128i a, __m128i b)
+{
+	auto zero = _mm_setzero_si128();
+	auto lo = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+	auto hi = _mm_sub_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+	return _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+}
+
+uint64_t sumSquaredDifferencesSSE2(const unsigned char* pixels0, const unsigned char* pixels1, size_t pixelCount, size_t relevantChannels)
+{
+	auto mask = _mm_set1_epi32(static_cast<int>(channelMask(relevantChannels)));
+	auto zero = _mm_setzero_si128();
+	auto sum64 = _mm_setzero_si128();
+
+	size_t pixel = 0;
+	while (pixel + 4 <= pixelCount)
+	{
+		auto sum32 = _mm_setzero_si128();
+		for (size_t i = 0; i < FlushInterval && pixel + 4 <= pixelCount; ++i, pixel += 4)
+		{
+			auto a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels0 + pixel * 4)), mask);
+			auto b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels1 + pixel * 4)), mask);
+			sum32 = _mm_add_epi32(sum32, squaredDifferences(a, b));
+		}
+
+		sum64 = _mm_add_epi64(sum64, _mm_unpacklo_epi32(sum32, zero));
+		sum64 = _mm_add_epi64(sum64, _mm_unpackhi_epi32(sum32, zero));
+	}
+
+	alignas(16) uint64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum64);
+
+	auto tail = sumSquaredDifferencesScalar(pixels0 + pixel * 4, pixels1 + pixel * 4, pixelCount - pixel, relevantChannels);
+	return lanes[0] + lanes[1] + tail;
+}
+
+TARGET_AVX2
+uint64_t sumSquaredDifferencesAVX2(const unsigned char* pixels0, const unsigned char* pixels1, size_t pixelCount, size_t relevantChannels)
+{
+	auto mask = _mm256_set1_epi32(static_cast<int>(channelMask(relevantChannels)));
+	auto zero = _mm256_setzero_si256();
+	auto sum64 = _mm256_setzero_si256();
+
+	size_t pixel = 0;
+	while (pixel + 8 <= pixelCount)
+	{
+		auto sum32 = _mm256_setzero_si256();
+		for (size_t i = 0; i < FlushInterval && pixel + 8 <= pixelCount; ++i, pixel += 8)
+		{
+			auto a = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels0 + pixel * 4)), mask);
+			auto b = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels1 + pixel * 4)), mask);
+			auto lo = _mm256_sub_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+			auto hi = _mm256_sub_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+			sum32 = _mm256_add_epi32(sum32, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+		}
+
+		sum64 = _mm256_add_epi64(sum64, _mm256_unpacklo_epi32(sum32, zero));
+		sum64 = _mm256_add_epi64(sum64, _mm256_unpackhi_epi32(sum32, zero));
+	}
+
+	alignas(32) uint64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum64);
+
+	auto tail = sumSquaredDifferencesSSE2(pixels0 + pixel * 4, pixels1 + pixel * 4, pixelCount - pixel, relevantChannels);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + tail;
+}
+// Full 4x4 block, at most 4 * 2 * 2 * 255^2 per 32-bit lane
+uint64_t blockSquaredDifferences(const unsigned char* source, size_t sourcePitch, const unsigned char decoded[64], __m128i mask)
+{
+	auto sum = _mm_setzero_si128();
+	for (size_t row = 0; row < 4; ++row)
+	{
+		auto a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + row * sourcePitch)), mask);
+		auto b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(decoded + row * 16)), mask);
+		sum = _mm_add_epi32(sum, squaredDifferences(a, b));
+	}
+
+	alignas(16) uint32_t lanes[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+	return static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+// Blocks on the right and bottom edges of images that are not a multiple of 4
+uint64_t partialBlockSquaredDifferences(
+	const unsigned char* source, size_t sourcePitch, const unsigned char decoded[64],
+	size_t columns, size_t rows, size_t relevantChannels)
+{
+	uint64_t sum = 0;
+	for (size_t row = 0; row < rows; ++row)
+	{
+		sum += sumSquaredDifferencesScalar(source + row * sourcePitch, decoded + row * 16, columns, relevantChannels);
+	}
+
+	return sum;
+}
+
+// Decodes one block row of a format without a native block decoder
+bool decodeBlockRow(const CompressedImage& compressed, size_t blockRow, CompressedImage& strip, UncompressedImage& decoded)
+{
+	auto rowBytes = ((compressed.width + 3) / 4) * blockSize(compressed.format);
+	auto begin = compressed.bytes.begin() + blockRow * rowBytes;
+
+	strip.format = compressed.format;
+	strip.width = compressed.width;
+	strip.height = std::min<size_t>(4, compressed.height - blockRow * 4);
+	strip.bytes.assign(begin, begin + rowBytes);
+
+	return genericDecompress(strip, UncompressedFormat::RGBA8, decoded);
+}
+} // namespace
+
+bool computeBlockErrors(
+	const UncompressedImage& source,
+	const CompressedImage& compressed,
+	size_t relevantChannels,
+	size_t threadCount,
+	uint64_t& squaredErrorSum,
+	std::vector<uint64_t>* blockErrors)
+{
+	auto width = source.width;
+	auto height = source.height;
+	auto blocksX = (width + 3) / 4;
+	auto blocksY = (height + 3) / 4;
+	auto pitch = width * 4;
+
+	if (compressed.bytes.size() < blocksX * blocksY * blockSize(compressed.format))
+	{
+		return false;
+	}
+
+	if (blockErrors != nullptr)
+	{
+		blockErrors->assign(blocksX * blocksY, 0);
+	}
+
+	auto mask = _mm_set1_epi32(static_cast<int>(channelMask(relevantChannels)));
+	auto nativeDecoder = hasBlockDecoder(compressed.format);
+	threadCount = std::min(threadCount, std::max<size_t>(width * height / MinPixelsPerThread, 1));
+
+	std::atomic<uint64_t> sum = 0;
+	std::atomic<bool> succeeded = true;
+	parallelFor(blocksY, threadCount, [&](size_t begin, size_t end)
+	{
+		CompressedImage strip;
+		UncompressedImage decodedStrip;
+		alignas(16) unsigned char decoded[64];
+		uint64_t localSum = 0;
+
+		for (size_t by = begin; by < end; ++by)
+		{
+			if (!nativeDecoder && !decodeBlockRow(compressed, by, strip, decodedStrip))
+			{
+				succeeded = false;
+				return;
+			}
+
+			auto rows = std::min<size_t>(4, height - by * 4);
+			for (size_t bx = 0; bx < blocksX; ++bx)
+			{
+				auto columns = std::min<size_t>(4, width - bx * 4);
+				if (nativeDecoder)
+				{
+					auto block = compressed.bytes.data() + (by * blocksX + bx) * blockSize(compressed.format);
+					decodeBlock(compressed.format, block, decoded);
+				}
+				else
+				{
+					for (size_t row = 0; row < rows; ++row)
+					{
+						std::memcpy(decoded + row * 16, decodedStrip.bytes.data() + row * pitch + bx * 16, columns * 4);
+					}
+				}
+
+				auto sourceBlock = source.bytes.data() + by * 4 * pitch + bx * 16;
+				auto blockSum = (columns == 4 && rows == 4) ?
+					blockSquaredDifferences(sourceBlock, pitch, decoded, mask) :
+					partialBlockSquaredDifferences(sourceBlock, pitch, decoded, columns, rows, relevantChannels);
+
+				if (blockErrors != nullptr)
+				{
+					(*blockErrors)[by * blocksX + bx] = blockSum;
+				}
+				localSum += blockSum;
+			}
+		}
+
+		sum += localSum;
+	});
+
+	squaredErrorSum = sum;
+	return succeeded;
+}
+
+uint64_t sumSquaredDifferences(const unsigned char* pixels0, const unsigned char* pixels1, size_t pixelCount, size_t relevantChannels)
+{
+	if (cpuHasAVX2())
+	{
+		return sumSquaredDifferencesAVX2(pixels0, pixels1, pixelCount, relevantChannels);
+	}
+
+	return sumSquaredDifferencesSSE2(pixels0, pixels1, pixelCount, relevantChannels);
+}
+
+void ErrorCalculator::addSamples(const UncompressedImage& image0, const UncompressedImage& image1)
+{
+	auto width = image0.width;
+	auto height = image0.height;
+	auto threadCount = std::min(m_threadCount, std::max<size_t>(width * height / MinPixelsPerThread, 1));
+
+	// Whole rows per band, each band reduces into its own 64-bit sum
+	std::atomic<uint64_t> sum = 0;
+	parallelFor(height, threadCount, [&](size_t begin, size_t end)
+	{
+		auto offset = begin * width * 4;
+		sum += sumSquaredDifferences(
+			image0.bytes.data() + offset,
+			image1.bytes.data() + offset,
+			(end - begin) * width,
+			m_relevantChannels);
+	});
+
+	addSquaredErrors(sum, static_cast<uint64_t>(width) * height * m_relevantChannels);
+}
+
+bool ErrorCalculator::addCompressedSamples(const UncompressedImage& source, const CompressedImage& compressed)
+{
+	uint64_t squaredErrorSum;
+	if (!computeBlockErrors(source, compressed, m_relevantChannels, m_threadCount, squaredErrorSum))
+	{
+		return false;
+	}
+
+	addSquaredErrors(squaredErrorSum, static_cast<uint64_t>(source.width) * source.height * m_relevantChannels);
+	return true;
+}
+
+void ErrorCalculator::addSquaredErrors(uint64_t squaredErrorSum, uint64_t sampleCount)
+{
+	m_squaredErrorSum += squaredErrorSum;
+	m_sampleCount += sampleCount;
+}
+
+double ErrorCalculator::calculateError() const
+{
+	if (m_sampleCount == 0)
+	{
+		return 0.0;
+	}
+
+	return std::sqrt(static_cast<double>(m_squaredErrorSum) / static_cast<double>(m_sampleCount)) / 255.0;
+}
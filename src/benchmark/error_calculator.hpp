@@ -0,0 +1,48 @@
+#pragma once
+
+#include "codec.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Exact sum of squared differences of the first relevantChannels channels of two RGBA8 pixel arrays
+uint64_t sumSquaredDifferences(const unsigned char* pixels0, const unsigned char* pixels1, size_t pixelCount, size_t relevantChannels);
+
+// Decodes the compressed image one 4x4 block at a time and compares every block against the source
+// right away, so the decoded image is never materialized. Formats without a native block decoder
+// are decoded one block row at a time through genericDecompress. When blockErrors is given it
+// receives the sum of squared differences of every block in row-major block order.
+bool computeBlockErrors(
+	const UncompressedImage& source,
+	const CompressedImage& compressed,
+	size_t relevantChannels,
+	size_t threadCount,
+	uint64_t& squaredErrorSum,
+	std::vector<uint64_t>* blockErrors = nullptr);
+
+// Accumulates RMSE over a number of image pairs. Large images are split into row bands processed in parallel.
+class ErrorCalculator final
+{
+public:
+	ErrorCalculator(size_t relevantChannels, size_t threadCount = 1)
+		: m_relevantChannels(relevantChannels)
+		, m_threadCount(threadCount)
+	{}
+
+	void addSamples(const UncompressedImage& image0, const UncompressedImage& image1);
+
+	// Same as addSamples on the decompressed image but fused with decoding, see computeBlockErrors
+	bool addCompressedSamples(const UncompressedImage& source, const CompressedImage& compressed);
+
+	// Adds an externally computed sum, sampleCount counts channels rather than pixels
+	void addSquaredErrors(uint64_t squaredErrorSum, uint64_t sampleCount);
+
+	// RMSE normalized to [0, 1]
+	double calculateError() const;
+
+private:
+	uint64_t m_squaredErrorSum = 0;
+	uint64_t m_sampleCount = 0;
+	const size_t m_relevantChannels;
+	const size_t m_threadCount;
+};
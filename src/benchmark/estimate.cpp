@@ -0,0 +1,229 @@
+#include "estimate.hpp"
+#include "configuration.hpp"
+#include "error_calculator.hpp"
+#include "report.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+namespace
+{
+// Two-sided 95% interval of a normal distribution
+const double ConfidenceZ = 1.96;
+
+// FNV-1a, unlike std::hash the same everywhere, so tile positions don't depend on the standard library
+uint64_t hashName(const std::string& name)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (auto c : name)
+	{
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+// Running estimate of a total over all images and its variance
+struct TotalEstimate
+{
+	double total = 0.0;
+	double variance = 0.0;
+
+	// Adds an image from the per-pixel values of its sampled tiles, out of tileCount tiles in the image
+	void addImage(const std::vector<double>& perPixel, size_t tileCount, double imagePixels)
+	{
+		auto n = static_cast<double>(perPixel.size());
+		auto mean = std::accumulate(std::begin(perPixel), std::end(perPixel), 0.0) / n;
+		total += mean * imagePixels;
+
+		if (perPixel.size() < 2)
+		{
+			return;
+		}
+
+		double squares = 0.0;
+		for (auto value : perPixel)
+		{
+			squares += (value - mean) * (value - mean);
+		}
+
+		auto sampleVariance = squares / (n - 1.0);
+		auto populationCorrection = 1.0 - n / static_cast<double>(tileCount);
+		variance += imagePixels * imagePixels * sampleVariance / n * populationCorrection;
+	}
+
+	double low() const { return std::max(0.0, total - ConfidenceZ * std::sqrt(variance)); }
+	double high() const { return total + ConfidenceZ * std::sqrt(variance); }
+};
+
+UncompressedImage extractTile(const UncompressedImage& image, size_t x, size_t y, size_t size)
+{
+	UncompressedImage tile;
+	tile.format = image.format;
+	tile.width = size;
+	tile.height = size;
+	tile.bytes.resize(size * size * 4);
+
+	for (size_t row = 0; row < size; ++row)
+	{
+		std::memcpy(tile.bytes.data() + row * size * 4, image.bytes.data() + ((y + row) * image.width + x) * 4, size * 4);
+	}
+
+	return tile;
+}
+
+double normalizedRmse(double squaredErrorSum, double sampleCount)
+{
+	return sampleCount > 0.0 ? std::sqrt(std::max(0.0, squaredErrorSum) / sampleCount) / 255.0 : 0.0;
+}
+} // namespace
+
+Estimate estimate(Codec& codec, const DataSet& dataSet, CompressedFormat format, const EstimateSettings& settings, const Benchmark::Settings& benchmarkSettings)
+{
+	Estimate result;
+	result.codecThreadCount = codec.threadCount();
+	TotalEstimate nanoseconds;
+	TotalEstimate squaredErrors;
+
+	auto channels = relevantChannels(format);
+	auto tileSize = std::max<size_t>(4, settings.tileSize / 4 * 4);
+	auto runCount = benchmarkSettings.warmupRuns + std::max<size_t>(benchmarkSettings.repetitions, 1);
+
+	CompressedImage compressed;
+	for (const auto& entry : dataSet)
+	{
+		const auto& image = entry.image;
+		auto imagePixels = static_cast<double>(image.width) * image.height;
+
+		// Images smaller than a tile are their own single tile
+		auto tilesX = image.width / tileSize;
+		auto tilesY = image.height / tileSize;
+		auto tileCount = tilesX * tilesY;
+		auto wholeImage = tileCount == 0;
+
+		std::vector<size_t> tiles(wholeImage ? 1 : tileCount);
+		std::iota(std::begin(tiles), std::end(tiles), size_t(0));
+
+		// Partial Fisher-Yates shuffle, the first tilesPerImage entries are the sample
+		std::mt19937_64 random(settings.seed ^ hashName(entry.name));
+		auto sampleCount = std::min(std::max<size_t>(settings.tilesPerImage, 1), tiles.size());
+		for (size_t i = 0; i < sampleCount; ++i)
+		{
+			std::swap(tiles[i], tiles[i + random() % (tiles.size() - i)]);
+		}
+
+		std::vector<double> tileNanoseconds;
+		std::vector<double> tileSquaredErrors;
+		size_t imageSampledPixels = 0;
+		auto imageFailed = false;
+		for (size_t i = 0; i < sampleCount && !imageFailed; ++i)
+		{
+			auto tile = wholeImage ? image : extractTile(image, (tiles[i] % tilesX) * tileSize, (tiles[i] / tilesX) * tileSize, tileSize);
+			auto tilePixels = static_cast<double>(tile.width) * tile.height;
+
+			TraceZone zone("compress tile", entry.name);
+			std::vector<double> samples;
+			auto succeeded = true;
+			for (size_t run = 0; run < runCount && succeeded; ++run)
+			{
+				auto start = Clock::now();
+				succeeded = codec.compress(tile, format, compressed);
+				auto end = Clock::now();
+
+				if (run >= benchmarkSettings.warmupRuns)
+				{
+					samples.push_back(static_cast<double>(elapsedNanoseconds(start, end)));
+				}
+			}
+
+			uint64_t squaredErrorSum = 0;
+			if (!succeeded || !computeBlockErrors(tile, compressed, channels, 1, squaredErrorSum))
+			{
+				std::cerr << "Failed to compress a tile of " << entry.name << std::endl;
+				result.hasErrors = true;
+				imageFailed = true;
+				continue;
+			}
+
+			tileNanoseconds.push_back(computeStatistics(samples).median / tilePixels);
+			tileSquaredErrors.push_back(static_cast<double>(squaredErrorSum) / tilePixels);
+			imageSampledPixels += tile.width * tile.height;
+		}
+
+		// A failed image is left out as a whole, so that the totals and the RMSE cover the same pixels
+		if (imageFailed)
+		{
+			continue;
+		}
+
+		result.totalPixels += image.width * image.height;
+		result.processedBytes += image.bytes.size();
+		result.sampledPixels += imageSampledPixels;
+		result.sampledTiles += tileNanoseconds.size();
+
+		nanoseconds.addImage(tileNanoseconds, tiles.size(), imagePixels);
+		squaredErrors.addImage(tileSquaredErrors, tiles.size(), imagePixels);
+	}
+
+	result.seconds = nanoseconds.total * 1e-9;
+	result.secondsLow = nanoseconds.low() * 1e-9;
+	result.secondsHigh = nanoseconds.high() * 1e-9;
+
+	auto samples = static_cast<double>(result.totalPixels) * channels;
+	result.error = normalizedRmse(squaredErrors.total, samples);
+	result.errorLow = normalizedRmse(squaredErrors.low(), samples);
+	result.errorHigh = normalizedRmse(squaredErrors.high(), samples);
+
+	return result;
+}
+
+Benchmark::Results toResults(const Estimate& estimate)
+{
+	Benchmark::Results results;
+	results.hasErrors = estimate.hasErrors;
+	results.processedBytes = estimate.processedBytes;
+	results.elapsedSeconds = estimate.seconds;
+	results.throughputBytesPerSec = estimate.seconds > 0.0 ? static_cast<size_t>(estimate.processedBytes / estimate.seconds) : 0;
+	results.compressionError = estimate.error;
+	results.threadCount = 1;
+	results.codecThreadCount = estimate.codecThreadCount;
+	results.peakResidentBytes = 0;
+	results.nanosecondsPerBlock = estimate.totalPixels > 0 ? estimate.seconds * 1e9 * 16 / estimate.totalPixels : 0.0;
+	results.perfCounterBlocks = 0;
+
+	// No pass was timed as a whole, the estimate is all there is to its statistics
+	results.passNanoseconds = computeStatistics({ estimate.seconds * 1e9 });
+
+	results.interval.available = true;
+	results.interval.secondsLow = estimate.secondsLow;
+	results.interval.secondsHigh = estimate.secondsHigh;
+	results.interval.errorLow = estimate.errorLow;
+	results.interval.errorHigh = estimate.errorHigh;
+
+	return results;
+}
+
+void printEstimate(std::ostream& out, const Estimate& estimate)
+{
+	if (estimate.hasErrors)
+	{
+		out << "Estimate completed with errors!" << std::endl;
+	}
+
+	auto bytes = estimate.processedBytes;
+	auto throughput = [&](double seconds) { return formatBytes(seconds > 0.0 ? static_cast<size_t>(bytes / seconds) : 0); };
+
+	out << "Estimated time " << std::fixed << std::setprecision(4) << estimate.seconds << " sec ";
+	out << "[" << estimate.secondsLow << ", " << estimate.secondsHigh << "]\t\t";
+	out << "Throughput " << throughput(estimate.seconds) << "/sec [" << throughput(estimate.secondsHigh) << ", " << throughput(estimate.secondsLow) << "]\t\t";
+	out << "Error " << std::setprecision(5) << estimate.error << " [" << estimate.errorLow << ", " << estimate.errorHigh << "]" << std::endl;
+	out << "Sampled " << estimate.sampledTiles << " tiles, " << std::setprecision(2);
+	out << (estimate.totalPixels > 0 ? 100.0 * estimate.sampledPixels / estimate.totalPixels : 0.0) << "% of all pixels, 95% confidence intervals" << std::endl;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "benchmark.hpp"
+
+#include <cstdint>
+#include <ostream>
+
+struct EstimateSettings
+{
+	// Square tiles, a multiple of 4 so that tiles are made of whole blocks
+	size_t tileSize = 64;
+	size_t tilesPerImage = 8;
+	// The same seed picks the same tiles on every run and machine
+	uint64_t seed = 1;
+};
+
+// Point estimates for the whole data set with 95% confidence intervals
+struct Estimate
+{
+	size_t sampledTiles = 0;
+	size_t sampledPixels = 0;
+	// Of the images in the estimate, those with a tile that failed to compress are left out
+	size_t totalPixels = 0;
+	size_t processedBytes = 0;
+	size_t codecThreadCount = 0;
+
+	double seconds = 0.0;
+	double secondsLow = 0.0;
+	double secondsHigh = 0.0;
+
+	double error = 0.0;
+	double errorLow = 0.0;
+	double errorHigh = 0.0;
+
+	bool hasErrors = false;
+};
+
+// Compresses a deterministic random sample of tiles of every image as separate images through the codec,
+// and extrapolates compression time and RMSE to the whole data set. Tiles are the sampling units of each
+// image, whose totals are estimated from the mean per-pixel time and squared error of its tiles with the
+// finite population correction, and summed over images. Every tile is compressed warmupRuns + repetitions
+// times and its median is used. Per-call overhead of the codec is paid once per tile rather than per image,
+// so the time estimate is biased upwards for codecs with expensive calls; larger tiles reduce that.
+Estimate estimate(Codec& codec, const DataSet& dataSet, CompressedFormat format, const EstimateSettings& settings, const Benchmark::Settings& benchmarkSettings);
+
+// Results with the point estimates as a single pass and the intervals in Results::interval
+Benchmark::Results toResults(const Estimate& estimate);
+
+void printEstimate(std::ostream& out, const Estimate& estimate);
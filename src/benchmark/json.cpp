@@ -0,0 +1,291 @@
+#include "json.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+namespace
+{
+class Parser final
+{
+public:
+	Parser(const std::string& text) : m_text(text) {}
+
+	bool parseDocument(JsonValue& value)
+	{
+		if (!parseValue(value, 0))
+		{
+			return false;
+		}
+
+		skipWhitespace();
+		return m_position == m_text.size();
+	}
+
+private:
+	// Deeper nesting than this only comes from broken or hostile input
+	static const size_t MaxDepth = 64;
+
+	void skipWhitespace()
+	{
+		while (m_position < m_text.size() && std::strchr(" \t\r\n", m_text[m_position]) != nullptr)
+		{
+			++m_position;
+		}
+	}
+
+	bool consume(char c)
+	{
+		skipWhitespace();
+		if (m_position < m_text.size() && m_text[m_position] == c)
+		{
+			++m_position;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool consumeLiteral(const char* literal)
+	{
+		auto length = std::strlen(literal);
+		if (m_text.compare(m_position, length, literal) == 0)
+		{
+			m_position += length;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool parseValue(JsonValue& value, size_t depth)
+	{
+		skipWhitespace();
+		if (m_position >= m_text.size() || depth > MaxDepth)
+		{
+			return false;
+		}
+
+		switch (m_text[m_position])
+		{
+		case '{': return parseObject(value, depth);
+		case '[': return parseArray(value, depth);
+		case '"':
+			value.type = JsonValue::Type::String;
+			return parseString(value.string);
+		case 't':
+			value.type = JsonValue::Type::Boolean;
+			value.boolean = true;
+			return consumeLiteral("true");
+		case 'f':
+			value.type = JsonValue::Type::Boolean;
+			value.boolean = false;
+			return consumeLiteral("false");
+		case 'n':
+			value.type = JsonValue::Type::Null;
+			return consumeLiteral("null");
+		default:
+			return parseNumber(value);
+		}
+	}
+
+	bool parseNumber(JsonValue& value)
+	{
+		auto begin = m_text.c_str() + m_position;
+		char* end = nullptr;
+		value.type = JsonValue::Type::Number;
+		value.number = std::strtod(begin, &end);
+		if (end == begin)
+		{
+			return false;
+		}
+
+		m_position += end - begin;
+		return true;
+	}
+
+	void appendUtf8(std::string& str, unsigned codePoint)
+	{
+		if (codePoint < 0x80)
+		{
+			str += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800)
+		{
+			str += static_cast<char>(0xC0 | (codePoint >> 6));
+			str += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			str += static_cast<char>(0xE0 | (codePoint >> 12));
+			str += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			str += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	bool parseString(std::string& str)
+	{
+		if (!consume('"'))
+		{
+			return false;
+		}
+
+		while (m_position < m_text.size())
+		{
+			auto c = m_text[m_position++];
+			if (c == '"')
+			{
+				return true;
+			}
+			else if (c != '\\')
+			{
+				str += c;
+				continue;
+			}
+
+			if (m_position >= m_text.size())
+			{
+				return false;
+			}
+
+			auto escaped = m_text[m_position++];
+			switch (escaped)
+			{
+			case 'b': str += '\b'; break;
+			case 'f': str += '\f'; break;
+			case 'n': str += '\n'; break;
+			case 'r': str += '\r'; break;
+			case 't': str += '\t'; break;
+			case 'u':
+			{
+				if (m_position + 4 > m_text.size())
+				{
+					return false;
+				}
+
+				auto hex = m_text.substr(m_position, 4);
+				char* end = nullptr;
+				auto codePoint = std::strtoul(hex.c_str(), &end, 16);
+				if (end != hex.c_str() + 4)
+				{
+					return false;
+				}
+
+				appendUtf8(str, static_cast<unsigned>(codePoint));
+				m_position += 4;
+				break;
+			}
+			default:
+				str += escaped;
+				break;
+			}
+		}
+
+		return false;
+	}
+
+	bool parseArray(JsonValue& value, size_t depth)
+	{
+		value.type = JsonValue::Type::Array;
+		consume('[');
+		if (consume(']'))
+		{
+			return true;
+		}
+
+		do
+		{
+			value.array.emplace_back();
+			if (!parseValue(value.array.back(), depth + 1))
+			{
+				return false;
+			}
+		} while (consume(','));
+
+		return consume(']');
+	}
+
+	bool parseObject(JsonValue& value, size_t depth)
+	{
+		value.type = JsonValue::Type::Object;
+		consume('{');
+		if (consume('}'))
+		{
+			return true;
+		}
+
+		do
+		{
+			std::string key;
+			skipWhitespace();
+			if (!parseString(key) || !consume(':'))
+			{
+				return false;
+			}
+
+			value.members.emplace_back(std::move(key), JsonValue());
+			if (!parseValue(value.members.back().second, depth + 1))
+			{
+				return false;
+			}
+		} while (consume(','));
+
+		return consume('}');
+	}
+
+	const std::string& m_text;
+	size_t m_position = 0;
+};
+} // namespace
+
+const JsonValue* JsonValue::find(const std::string& key) const
+{
+	for (const auto& member : members)
+	{
+		if (member.first == key)
+		{
+			return &member.second;
+		}
+	}
+
+	return nullptr;
+}
+
+double JsonValue::numberOr(const std::string& key, double fallback) const
+{
+	auto member = find(key);
+	return member != nullptr && member->type == Type::Number ? member->number : fallback;
+}
+
+std::string JsonValue::stringOr(const std::string& key, const std::string& fallback) const
+{
+	auto member = find(key);
+	return member != nullptr && member->type == Type::String ? member->string : fallback;
+}
+
+bool parseJson(const std::string& text, JsonValue& value)
+{
+	value = JsonValue();
+	return Parser(text).parseDocument(value);
+}
+
+void writeJsonString(std::ostream& out, const std::string& str)
+{
+	out << '"';
+	for (auto c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+		}
+		else
+		{
+			out << c;
+		}
+	}
+	out << '"';
+}
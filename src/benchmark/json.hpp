@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON to read back the result files the benchmark writes itself
+struct JsonValue
+{
+	enum class Type
+	{
+		Null,
+		Boolean,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	// Member lookup, nullptr when this isn't an object or has no such member
+	const JsonValue* find(const std::string& key) const;
+	double numberOr(const std::string& key, double fallback) const;
+	std::string stringOr(const std::string& key, const std::string& fallback) const;
+};
+
+bool parseJson(const std::string& text, JsonValue& value);
+
+// Writes str as a quoted JSON string with the required escapes
+void writeJsonString(std::ostream& out, const std::string& str);
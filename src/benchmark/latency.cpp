@@ -0,0 +1,132 @@
+#include "latency.hpp"
+#include "error_calculator.hpp"
+#include "report.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+Benchmark::Results measureLatency(const Configuration& config, const DataSetImage& image, bool firstInProcess, const Benchmark::Settings& settings)
+{
+	Benchmark::Results results;
+	results.hasErrors = true;
+	results.processedBytes = 0;
+	results.elapsedSeconds = 0.0;
+	results.throughputBytesPerSec = 0;
+	results.compressionError = 0.0;
+	results.threadCount = 1;
+	results.codecThreadCount = settings.codecThreadCount;
+	results.peakResidentBytes = 0;
+	results.nanosecondsPerBlock = 0.0;
+	results.perfCounterBlocks = 0;
+	results.startup.firstInProcess = firstInProcess;
+
+	std::unique_ptr<Codec> codec;
+	{
+		TraceZone zone("construct codec", describe(config));
+		auto start = Clock::now();
+		codec = makeCodec(config);
+		auto end = Clock::now();
+		results.startup.constructionSeconds = elapsedNanoseconds(start, end) * 1e-9;
+	}
+
+	if (!codec)
+	{
+		std::cerr << "Failed to construct the codec of " << describe(config) << std::endl;
+		return results;
+	}
+	codec->setThreadCount(settings.codecThreadCount);
+
+	CompressedImage compressed;
+	{
+		TraceZone zone("first compress", image.name);
+		auto start = Clock::now();
+		auto succeeded = codec->compress(image.image, config.format, compressed);
+		auto end = Clock::now();
+		results.startup.firstCompressSeconds = elapsedNanoseconds(start, end) * 1e-9;
+
+		if (!succeeded)
+		{
+			std::cerr << "Failed to compress image " << image.name << std::endl;
+			return results;
+		}
+	}
+
+	std::vector<double> nanoseconds;
+	std::vector<double> cycles;
+	for (size_t run = 0, runCount = settings.warmupRuns + std::max<size_t>(settings.repetitions, 1); run < runCount; ++run)
+	{
+		TraceZone zone("compress", image.name);
+		auto startCycles = readCycleCounter();
+		auto start = Clock::now();
+		auto succeeded = codec->compress(image.image, config.format, compressed);
+		auto end = Clock::now();
+		auto endCycles = readCycleCounter();
+
+		if (!succeeded)
+		{
+			std::cerr << "Failed to compress image " << image.name << std::endl;
+			return results;
+		}
+
+		if (run >= settings.warmupRuns)
+		{
+			nanoseconds.push_back(static_cast<double>(elapsedNanoseconds(start, end)));
+			cycles.push_back(static_cast<double>(endCycles - startCycles));
+		}
+	}
+
+	auto channels = relevantChannels(config.format);
+	uint64_t squaredErrorSum = 0;
+	if (!computeBlockErrors(image.image, compressed, channels, 1, squaredErrorSum))
+	{
+		std::cerr << "Failed to decode the compressed image " << image.name << std::endl;
+		return results;
+	}
+
+	auto blocks = ((image.image.width + 3) / 4) * ((image.image.height + 3) / 4);
+	auto samples = static_cast<double>(image.image.width) * image.image.height * channels;
+
+	results.hasErrors = false;
+	results.processedBytes = image.image.bytes.size();
+	results.passNanoseconds = computeStatistics(nanoseconds);
+	results.elapsedSeconds = results.passNanoseconds.median * 1e-9;
+	results.throughputBytesPerSec = results.elapsedSeconds > 0.0 ? static_cast<size_t>(results.processedBytes / results.elapsedSeconds) : 0;
+	results.compressionError = samples > 0.0 ? std::sqrt(squaredErrorSum / samples) / 255.0 : 0.0;
+	results.codecThreadCount = codec->threadCount();
+	results.nanosecondsPerBlock = blocks > 0 ? results.passNanoseconds.median / blocks : 0.0;
+
+	Benchmark::ImageResults imageResults;
+	imageResults.name = image.name;
+	imageResults.width = image.image.width;
+	imageResults.height = image.image.height;
+	imageResults.elapsedNanoseconds = results.passNanoseconds;
+	imageResults.cyclesPerBlock = blocks > 0 ? computeStatistics(cycles).median / blocks : 0.0;
+	results.images.push_back(std::move(imageResults));
+
+	// Only with the steady state measured, so printLatency always has an image
+	results.startup.available = true;
+
+	return results;
+}
+
+void printLatency(std::ostream& out, const Benchmark::Results& results)
+{
+	const auto& startup = results.startup;
+	if (!startup.available)
+	{
+		out << "Latency measurement failed!" << std::endl;
+		return;
+	}
+
+	const auto& image = results.images.front();
+	out << "Construction " << std::fixed << std::setprecision(3) << startup.constructionSeconds * 1e3 << " ms";
+	out << (startup.firstInProcess ? " (first in process)" : "") << "\t\t";
+	out << "First compress " << startup.firstCompressSeconds * 1e3 << " ms\t\t";
+	out << "Time to first texture " << (startup.constructionSeconds + startup.firstCompressSeconds) * 1e3 << " ms" << std::endl;
+	out << "Steady state (ms): " << formatStatistics(results.passNanoseconds, 1e-6) << "\t\t";
+	out << image.name << " (" << image.width << "x" << image.height << ")\t\tError " << std::setprecision(5) << results.compressionError << std::endl;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "configuration.hpp"
+
+#include <ostream>
+
+// Times the construction of the codec of config and its first compression of image, then makes
+// settings.warmupRuns untimed and settings.repetitions timed compressions of the same image for the
+// steady-state latency. The results cover that image alone, with the timed calls as passes.
+Benchmark::Results measureLatency(const Configuration& config, const DataSetImage& image, bool firstInProcess, const Benchmark::Settings& settings);
+
+void printLatency(std::ostream& out, const Benchmark::Results& results);
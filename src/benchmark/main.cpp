@@ -1,139 +1,159 @@
+#include "ab_test.hpp"
+#include "baseline.hpp"
 #include "benchmark.hpp"
-#include "compressonator_codec.hpp"
-#include "nvtt_codec.hpp"
-#include "directxtex_codec.hpp"
+#include "configuration.hpp"
+#include "estimate.hpp"
+#include "latency.hpp"
+#include "memory_stats.hpp"
+#include "parallel.hpp"
+#include "pareto.hpp"
+#include "report.hpp"
+#include "results_file.hpp"
+#include "roofline.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+#include "tuner.hpp"
 
 #include <argparse.h>
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <iostream>
-#include <sstream>
 #include <iomanip>
+#include <memory>
+#include <set>
 
 #include <string>
+#include <cctype>
 
 namespace
 {
-std::string formatBytes(size_t bytes)
+bool parseBytes(const std::string& str, size_t& bytes)
 {
-	static const char* prefixes[] = { "B", "KB", "MB", "GB", "TB" };
-	static const size_t prefixCount = sizeof(prefixes) / sizeof(prefixes[0]);
+	static const char* suffixes[] = { "B", "KB", "MB", "GB", "TB" };
+	static const size_t suffixCount = sizeof(suffixes) / sizeof(suffixes[0]);
 
-	size_t n = 0;
-	auto fbytes = static_cast<float>(bytes);
-	while (n < prefixCount - 1 && fbytes >= 1024.f)
+	size_t value = 0;
+	size_t length = 0;
+	while (length < str.size() && isdigit(static_cast<unsigned char>(str[length])))
 	{
-		++n;
-		fbytes /= 1024.f;
+		auto digit = static_cast<size_t>(str[length] - '0');
+		if (value > (std::numeric_limits<size_t>::max() - digit) / 10)
+		{
+			return false;
+		}
+		value = value * 10 + digit;
+		++length;
 	}
 
-	std::stringstream buffer;
-	if (n == 0 || fbytes >= 100.f || fbytes - static_cast<size_t>(fbytes) < 0.05f)
+	if (length == 0)
 	{
-		buffer << static_cast<size_t>(fbytes) << " " << prefixes[n];
+		return false;
 	}
-	else
+
+	auto suffix = str.substr(length);
+	if (suffix.empty())
 	{
-		fbytes = std::round(fbytes * 10.f) / 10.f;
-		buffer << std::fixed << std::setprecision(1) << fbytes << " " << prefixes[n];
+		bytes = value;
+		return true;
 	}
 
-	return buffer.str();
+	for (size_t n = 0; n < suffixCount; ++n)
+	{
+		if (suffix == suffixes[n])
+		{
+			if (value > (std::numeric_limits<size_t>::max() >> (10 * n)))
+			{
+				return false;
+			}
+			bytes = value << (10 * n);
+			return true;
+		}
+	}
+
+	return false;
 }
 
 struct Parameters
 {
-	enum class Codec
+	enum class Mode
 	{
-		Compressonator,
-		NVTT,
-		DirectXTex,
+		Compress,
+		Decompress,
 	};
 
 	std::string inputDir;
-	CompressedFormat format;
-	CompressionQuality quality;
-	Codec codec;
-	bool useGPU;
-	bool bc7Quick;
-	bool bc7Use3Subsets;
+	Mode mode;
+	Matrix matrix;
+	bool perImage;
+	bool scalingSweep;
+	bool threadSplit;
+	bool cacheStates;
+	bool soak;
+	SoakSettings soakSettings;
+	std::string traceFile;
+	std::string jsonFile;
+	std::string csvFile;
+	std::string baselineFile;
+	BaselineThresholds thresholds;
+	bool pareto;
+	ParetoMetric paretoMetric;
+	std::string paretoDir;
+	bool roofline;
+	bool tune;
+	TuneSettings tuneSettings;
+	bool estimate;
+	EstimateSettings estimateSettings;
+	bool abTest;
+	AbTestSettings abTestSettings;
+	bool latency;
+	Benchmark::Settings settings;
 };
 
-bool parseFormat(const std::string str, CompressedFormat& format)
+template <typename T, typename Parser>
+bool parseList(argparse::ArgumentParser& parser, const char* name, Parser parseValue, std::vector<T>& values)
 {
-	if (str == "bc1")
-	{
-		format = CompressedFormat::BC1;
-		return true;
-	}
-	else if (str == "bc3")
-	{
-		format = CompressedFormat::BC3;
-		return true;
-	}
-	else if (str == "bc4")
-	{
-		format = CompressedFormat::BC4;
-		return true;
-	}
-	else if (str == "bc5")
-	{
-		format = CompressedFormat::BC5;
-		return true;
-	}
-	else if (str == "bc6")
-	{
-		format = CompressedFormat::BC6;
-		return true;
-	}
-	else if (str == "bc7")
+	for (const auto& str : parser.get<std::vector<std::string>>(name))
 	{
-		format = CompressedFormat::BC7;
-		return true;
+		T value;
+		if (!parseValue(str, value))
+		{
+			std::cerr << "Unknown " << name << " " << str << std::endl;
+			return false;
+		}
+		values.push_back(value);
 	}
-	
+
 	return true;
 }
 
-bool parseCodec(const std::string& str, Parameters::Codec& codec)
+// A switch given without values is enabled, with values it becomes a matrix axis, e.g. "--gpu off on"
+bool parseSwitch(argparse::ArgumentParser& parser, const char* name, std::vector<bool>& values)
 {
-	if (str == "compressonator")
-	{
-		codec = Parameters::Codec::Compressonator;
-		return true;
-	}
-	else if (str == "nvtt")
+	if (!parser.exists(name))
 	{
-		codec = Parameters::Codec::NVTT;
-		return true;
-	}
-	else if (str == "directxtex")
-	{
-		codec = Parameters::Codec::DirectXTex;
+		values = { false };
 		return true;
 	}
 
-	return false;
-}
+	auto parseValue = [](const std::string& str, bool& value)
+	{
+		value = (str == "on");
+		return str == "on" || str == "off";
+	};
 
-bool parseQuality(const std::string& str, CompressionQuality& quality)
-{
-	if (str == "low")
+	if (!parseList(parser, name, parseValue, values))
 	{
-		quality = CompressionQuality::Low;
-		return true;
+		return false;
 	}
-	else if (str == "medium")
+
+	if (values.empty())
 	{
-		quality = CompressionQuality::Medium;
-		return true;
-	}
-	else if (str == "high")
-	{
-		quality = CompressionQuality::High;
-		return true;
+		values = { true };
 	}
 
-	return false;
+	return true;
 }
 
 bool parseParameters(int argc, const char* argv[], Parameters& params)
@@ -143,26 +163,158 @@ bool parseParameters(int argc, const char* argv[], Parameters& params)
 		.name("--input")
 		.description("path to a directory with textures to compress")
 		.required(true);
+	parser.add_argument()
+		.name("--mode")
+		.description("what to time [compress, decompress], default compress");
 	parser.add_argument()
 		.name("--format")
-		.description("compression format [bc1, bc3, bc4, bc5, bc6, bc7]")
+		.description("one or more compression formats [bc1, bc3, bc4, bc5, bc6, bc7]")
 		.required(true);
 	parser.add_argument()
 		.name("--codec")
-		.description("compressor implementation [compressonator, nvtt, directxtex]")
+		.description("one or more compressor implementations [compressonator, nvtt, directxtex]")
 		.required(true);
 	parser.add_argument()
 		.name("--quality")
-		.description("compression quality [low, medium, high]");
+		.description("one or more compression qualities [low, medium, high]");
 	parser.add_argument()
 		.name("--gpu")
-		.description("enable GPU");
+		.description("enable GPU, or [off, on] to run both");
 	parser.add_argument()
 		.name("--bc7quick")
-		.description("enable DirectXTex BC7 flag TEX_COMPRESS_BC7_QUICK");
+		.description("enable DirectXTex BC7 flag TEX_COMPRESS_BC7_QUICK, or [off, on] to run both");
 	parser.add_argument()
 		.name("--bc7use3subsets")
-		.description("enable DirectXTex BC7 flag TEX_COMPRESS_BC7_USE_3SUBSETS");
+		.description("enable DirectXTex BC7 flag TEX_COMPRESS_BC7_USE_3SUBSETS, or [off, on] to run both");
+	parser.add_argument()
+		.name("--metrics")
+		.description("quality metrics reported next to RMSE [psnr, ssim, msssim]");
+	parser.add_argument()
+		.name("--warmup")
+		.description("number of untimed passes over the data set [default 1]");
+	parser.add_argument()
+		.name("--repetitions")
+		.description("number of timed passes over the data set [default 3]");
+	parser.add_argument()
+		.name("--timebudget")
+		.description("stop a measurement after the images in progress once it has run this long, e.g. 10m, and extrapolate the rest of the data set");
+	parser.add_argument()
+		.name("--progress")
+		.description("print progress and an ETA of every measurement to stderr");
+	parser.add_argument()
+		.name("--perimage")
+		.description("report timing statistics for each image");
+	parser.add_argument()
+		.name("--threads")
+		.description("number of images compressed concurrently [default 1, 0 for all hardware threads]");
+	parser.add_argument()
+		.name("--scalingsweep")
+		.description("repeat the benchmark with 1, 2, 4... up to --threads threads and report the speedup");
+	parser.add_argument()
+		.name("--soak")
+		.description("compress the data set round after round for this long, e.g. 20m, on all hardware threads unless --threads is given, and report throttling and resident set growth");
+	parser.add_argument()
+		.name("--soakdir")
+		.description("write the --soak samples as CSV and a throughput chart as SVG to this directory");
+	parser.add_argument()
+		.name("--pin")
+		.description("pin worker threads to CPUs, either a list like 0-3,8 or physical for one CPU per physical core, codecs then get one thread per call");
+	parser.add_argument()
+		.name("--numa")
+		.description("place every image on the NUMA node of the pinned worker that compresses it [none, firsttouch, bind], default none");
+	parser.add_argument()
+		.name("--codecthreads")
+		.description("threads a codec may use inside one call [default --threads split over hardware threads, or the codec default with one thread]");
+	parser.add_argument()
+		.name("--threadsplit")
+		.description("split --threads threads between concurrent images and threads inside the codec in every way and report the best split per image size");
+	parser.add_argument()
+		.name("--cache")
+		.description("caches before every timed call [loaded, cold, warm, both], cold evicts them, warm compresses the image right before, both reports cold and warm separately, default loaded");
+	parser.add_argument()
+		.name("--pipeline")
+		.description("stream images through load, compress and verify threads instead of loading the data set up front");
+	parser.add_argument()
+		.name("--memorybudget")
+		.description("cap for image bytes in flight in --pipeline mode, e.g. 512MB [default 1GB]");
+	parser.add_argument()
+		.name("--heatmapdir")
+		.description("write a per-block RMSE heatmap PNG of every image to this directory");
+	parser.add_argument()
+		.name("--worstblocks")
+		.description("dump source and decoded pixels of the N worst blocks of every image");
+	parser.add_argument()
+		.name("--blockhistogram")
+		.description("report a histogram of per-block RMSE for every image");
+	parser.add_argument()
+		.name("--perfcounters")
+		.description("count cycles, instructions, cache and branch misses around every timed call (Linux only)");
+	parser.add_argument()
+		.name("--memorystats")
+		.description("record peak RSS and heap allocations of every timed call");
+	parser.add_argument()
+		.name("--trace")
+		.description("write a timeline of loading, compression and verification in Chrome trace JSON format to this file");
+	parser.add_argument()
+		.name("--json")
+		.description("write all results and the run settings to this JSON file");
+	parser.add_argument()
+		.name("--csv")
+		.description("write all results to this CSV file, one row per configuration and per image");
+	parser.add_argument()
+		.name("--baseline")
+		.description("compare against a JSON file from a previous run and exit with code 2 on regressions");
+	parser.add_argument()
+		.name("--threshold")
+		.description("smallest slowdown in percent counted as a regression, noise of both runs is added [default 5]");
+	parser.add_argument()
+		.name("--errorthreshold")
+		.description("smallest RMSE increase in percent counted as a regression [default 0.1]");
+	parser.add_argument()
+		.name("--pareto")
+		.description("report the throughput vs error Pareto frontier of every format");
+	parser.add_argument()
+		.name("--paretometric")
+		.description("error axis of the Pareto frontier [rmse, psnr], default rmse");
+	parser.add_argument()
+		.name("--paretodir")
+		.description("write the Pareto frontiers as CSV and SVG files to this directory, implies --pareto");
+	parser.add_argument()
+		.name("--roofline")
+		.description("measure memory bandwidth and compute peak first and report whether every configuration is memory or compute bound, which takes --perfcounters and --codecthreads 1 for the compute floor");
+	parser.add_argument()
+		.name("--latency")
+		.description("time codec construction, the first compression and steady-state compression of the first image, for every configuration");
+	parser.add_argument()
+		.name("--tune")
+		.description("find the fastest configuration of every format with an error of at most --maxerror, all qualities and BC7 flags are tried unless given");
+	parser.add_argument()
+		.name("--maxerror")
+		.description("error target of --tune, as reported in the Error column");
+	parser.add_argument()
+		.name("--tunesamples")
+		.description("number of images every --tune candidate is first tried on [default 4]");
+	parser.add_argument()
+		.name("--estimate")
+		.description("compress only a random sample of tiles of every image and extrapolate time and error with confidence intervals");
+	parser.add_argument()
+		.name("--tilesize")
+		.description("side of the --estimate tiles in pixels, rounded down to a multiple of 4 [default 64]");
+	parser.add_argument()
+		.name("--tilesperimage")
+		.description("number of tiles --estimate samples from every image [default 8]");
+	parser.add_argument()
+		.name("--seed")
+		.description("seed of the --estimate tile sample and the --ab bootstrap [default 1]");
+	parser.add_argument()
+		.name("--ab")
+		.description("compare exactly two configurations, A and B, by compressing every image with both back to back, with a bootstrap interval of the throughput ratio");
+	parser.add_argument()
+		.name("--confidence")
+		.description("confidence level of the --ab interval [default 0.95]");
+	parser.add_argument()
+		.name("--bootstrap")
+		.description("number of bootstrap resamples of --ab [default 10000]");
 
 	if (auto err = parser.parse(argc, argv))
 	{
@@ -173,70 +325,416 @@ bool parseParameters(int argc, const char* argv[], Parameters& params)
 
 	params.inputDir = parser.get<std::string>("input");
 	
-	auto formatStr = parser.get<std::string>("format");
-	if (!parseFormat(formatStr, params.format))
+	if (!parseList(parser, "format", &parseFormat, params.matrix.formats) ||
+		!parseList(parser, "codec", &parseCodec, params.matrix.codecs) ||
+		!parseList(parser, "quality", &parseQuality, params.matrix.qualities) ||
+		!parseSwitch(parser, "gpu", params.matrix.useGPU) ||
+		!parseSwitch(parser, "bc7quick", params.matrix.bc7Quick) ||
+		!parseSwitch(parser, "bc7use3subsets", params.matrix.bc7Use3Subsets))
+	{
+		return false;
+	}
+
+	// Tuning searches every option that wasn't pinned down on the command line
+	params.tune = parser.exists("tune");
+	if (params.tune)
+	{
+		if (!parser.exists("maxerror"))
+		{
+			std::cerr << "--tune needs --maxerror" << std::endl;
+			return false;
+		}
+
+		params.tuneSettings.maxError = parser.get<double>("maxerror");
+		if (parser.exists("tunesamples"))
+		{
+			params.tuneSettings.sampleCount = parser.get<size_t>("tunesamples");
+		}
+
+		if (params.matrix.qualities.empty())
+		{
+			params.matrix.qualities = { CompressionQuality::Low, CompressionQuality::Medium, CompressionQuality::High };
+		}
+		if (!parser.exists("bc7quick"))
+		{
+			params.matrix.bc7Quick = { false, true };
+		}
+		if (!parser.exists("bc7use3subsets"))
+		{
+			params.matrix.bc7Use3Subsets = { false, true };
+		}
+	}
+
+	if (params.matrix.qualities.empty())
+	{
+		params.matrix.qualities = { CompressionQuality::Medium };
+	}
+
+	params.estimate = parser.exists("estimate");
+	if (parser.exists("tilesize"))
+	{
+		params.estimateSettings.tileSize = parser.get<size_t>("tilesize");
+	}
+	if (parser.exists("tilesperimage"))
+	{
+		params.estimateSettings.tilesPerImage = parser.get<size_t>("tilesperimage");
+	}
+	if (parser.exists("seed"))
+	{
+		params.estimateSettings.seed = parser.get<uint64_t>("seed");
+		params.abTestSettings.seed = params.estimateSettings.seed;
+	}
+
+	params.abTest = parser.exists("ab");
+	params.latency = parser.exists("latency");
+	if (parser.exists("confidence"))
+	{
+		params.abTestSettings.confidence = parser.get<double>("confidence");
+		if (params.abTestSettings.confidence <= 0.0 || params.abTestSettings.confidence >= 1.0)
+		{
+			std::cerr << "--confidence must be between 0 and 1" << std::endl;
+			return false;
+		}
+	}
+	if (parser.exists("bootstrap"))
+	{
+		params.abTestSettings.bootstrapResamples = parser.get<size_t>("bootstrap");
+	}
+
+	params.mode = Parameters::Mode::Compress;
+	if (parser.exists("mode"))
+	{
+		auto modeStr = parser.get<std::string>("mode");
+		if (modeStr == "decompress")
+		{
+			params.mode = Parameters::Mode::Decompress;
+		}
+		else if (modeStr != "compress")
+		{
+			std::cerr << "Unknown mode " << modeStr << std::endl;
+			return false;
+		}
+	}
+
+	for (const auto& metric : parser.get<std::vector<std::string>>("metrics"))
+	{
+		if (metric == "psnr")
+		{
+			params.settings.metrics.psnr = true;
+		}
+		else if (metric == "ssim")
+		{
+			params.settings.metrics.ssim = true;
+		}
+		else if (metric == "msssim")
+		{
+			params.settings.metrics.msssim = true;
+		}
+		else
+		{
+			std::cerr << "Unknown metric " << metric << std::endl;
+			return false;
+		}
+	}
+
+	params.perImage = parser.exists("perimage");
+	params.scalingSweep = parser.exists("scalingsweep");
+	params.threadSplit = parser.exists("threadsplit");
+	params.soak = parser.exists("soak");
+	if (params.soak && !parseDuration(parser.get<std::string>("soak"), params.soakSettings.durationSeconds))
+	{
+		std::cerr << "Invalid duration " << parser.get<std::string>("soak") << std::endl;
+		return false;
+	}
+	if (parser.exists("soakdir"))
+	{
+		params.soakSettings.chartDir = parser.get<std::string>("soakdir");
+	}
+
+	if (parser.exists("timebudget") && !parseDuration(parser.get<std::string>("timebudget"), params.settings.timeBudgetSeconds))
+	{
+		std::cerr << "Invalid duration " << parser.get<std::string>("timebudget") << std::endl;
+		return false;
+	}
+	params.settings.progress = parser.exists("progress");
+
+	if (parser.exists("heatmapdir"))
+	{
+		params.settings.blockErrors.heatmapDir = parser.get<std::string>("heatmapdir");
+	}
+	if (parser.exists("worstblocks"))
+	{
+		params.settings.blockErrors.worstBlockCount = parser.get<size_t>("worstblocks");
+	}
+	params.settings.blockErrors.histogram = parser.exists("blockhistogram");
+	params.settings.perfCounters = parser.exists("perfcounters");
+	params.settings.memoryStats = parser.exists("memorystats");
+
+	if (parser.exists("trace"))
+	{
+		params.traceFile = parser.get<std::string>("trace");
+	}
+	if (parser.exists("json"))
+	{
+		params.jsonFile = parser.get<std::string>("json");
+	}
+	if (parser.exists("csv"))
+	{
+		params.csvFile = parser.get<std::string>("csv");
+	}
+	if (parser.exists("baseline"))
+	{
+		params.baselineFile = parser.get<std::string>("baseline");
+	}
+	if (parser.exists("threshold"))
+	{
+		params.thresholds.timeTolerance = parser.get<double>("threshold") * 0.01;
+	}
+	if (parser.exists("errorthreshold"))
+	{
+		params.thresholds.errorTolerance = parser.get<double>("errorthreshold") * 0.01;
+	}
+
+	params.paretoMetric = ParetoMetric::RMSE;
+	if (parser.exists("paretometric") && !parseParetoMetric(parser.get<std::string>("paretometric"), params.paretoMetric))
+	{
+		return false;
+	}
+	if (parser.exists("paretodir"))
+	{
+		params.paretoDir = parser.get<std::string>("paretodir");
+	}
+	params.pareto = parser.exists("pareto") || !params.paretoDir.empty();
+	params.roofline = parser.exists("roofline");
+
+	// The PSNR frontier needs PSNR to be measured
+	if (params.pareto && params.paretoMetric == ParetoMetric::PSNR)
+	{
+		params.settings.metrics.psnr = true;
+	}
+
+	if (parser.exists("threads"))
+	{
+		params.settings.threadCount = parser.get<size_t>("threads");
+		if (params.settings.threadCount == 0)
+		{
+			params.settings.threadCount = hardwareThreadCount();
+		}
+	}
+	else if (params.scalingSweep || params.threadSplit || params.soak)
+	{
+		params.settings.threadCount = hardwareThreadCount();
+	}
+
+	if (parser.exists("pin"))
+	{
+		auto pinStr = parser.get<std::string>("pin");
+		if (pinStr == "physical")
+		{
+			params.settings.placement.cpus = physicalCoreCpus();
+			if (params.settings.placement.cpus.empty())
+			{
+				std::cerr << "Failed to read the physical cores" << std::endl;
+				return false;
+			}
+		}
+		else if (!parseCpuList(pinStr, params.settings.placement.cpus))
+		{
+			std::cerr << "Invalid CPU list " << pinStr << std::endl;
+			return false;
+		}
+	}
+
+	if (parser.exists("numa") && !parseNumaPlacement(parser.get<std::string>("numa"), params.settings.placement.numa))
 	{
-		std::cerr << "Unknown format " << formatStr << std::endl;
 		return false;
 	}
 
-	auto codecStr = parser.get<std::string>("codec");
-	if (!parseCodec(codecStr, params.codec))
+	if (params.settings.placement.numa != NumaPlacement::None && params.settings.placement.cpus.empty())
 	{
-		std::cerr << "Unknown codec " << codecStr << std::endl;
+		std::cerr << "--numa needs --pin" << std::endl;
 		return false;
 	}
 
-	if (parser.exists("quality"))
+	if (parser.exists("codecthreads"))
+	{
+		params.settings.codecThreadCount = parser.get<size_t>("codecthreads");
+	}
+
+	// Threads a codec starts inherit the affinity of their pinned worker and would share its one CPU
+	if (!params.settings.placement.cpus.empty())
 	{
-		auto qualityStr = parser.get<std::string>("quality");
-		if (!parseQuality(qualityStr, params.quality))
+		if (params.settings.codecThreadCount > 1 || params.threadSplit)
 		{
-			std::cerr << "Unknown quality " << qualityStr << std::endl;
+			std::cerr << "--pin can't be combined with --threadsplit or --codecthreads above 1" << std::endl;
 			return false;
 		}
+		params.settings.codecThreadCount = 1;
 	}
-	else
+
+	params.settings.pipelined = parser.exists("pipeline");
+
+	params.cacheStates = false;
+	if (parser.exists("cache"))
 	{
-		params.quality = CompressionQuality::Medium;
+		auto cacheStr = parser.get<std::string>("cache");
+		params.cacheStates = cacheStr == "both";
+		if (!params.cacheStates && !parseCacheState(cacheStr, params.settings.cacheState))
+		{
+			std::cerr << "Unknown cache " << cacheStr << std::endl;
+			return false;
+		}
 	}
 
-	params.useGPU = parser.exists("gpu");
-	params.bc7Quick = parser.exists("bc7quick");
-	params.bc7Use3Subsets = parser.exists("bc7use3subsets");
+	// Only the data set loaded up front goes through the passes that prepare the caches, and only compression does
+	auto cacheGiven = params.cacheStates || params.settings.cacheState != CacheState::Loaded;
+	if (cacheGiven && (params.tune || params.estimate || params.abTest || params.settings.pipelined || params.mode == Parameters::Mode::Decompress))
+	{
+		std::cerr << "--cache can't be combined with --tune, --estimate, --ab, --pipeline or --mode decompress" << std::endl;
+		return false;
+	}
 
-	return true;
-}
+	// Evicting on one worker flushes the caches of the others in the middle of their calls
+	if ((params.cacheStates || params.settings.cacheState == CacheState::Cold) && params.settings.threadCount > 1)
+	{
+		std::cerr << "--cache cold and both can't be combined with more than one thread" << std::endl;
+		return false;
+	}
 
-std::unique_ptr<Codec> makeCodec(const Parameters& params)
-{
-	switch (params.codec)
+	if (params.cacheStates && (params.soak || params.threadSplit || params.scalingSweep))
 	{
-	case Parameters::Codec::Compressonator:
-		return std::make_unique<CompressonatorCodec>();
-	
-	case Parameters::Codec::NVTT:
+		std::cerr << "--cache both can't be combined with other modes than compress" << std::endl;
+		return false;
+	}
+	if (params.settings.pipelined && params.scalingSweep)
 	{
-		auto codec = std::make_unique<NvttCodec>();
-		codec->setCudaEnabled(params.useGPU);
-		return codec;
+		std::cerr << "--scalingsweep can't be combined with --pipeline" << std::endl;
+		return false;
 	}
-	
-	case Parameters::Codec::DirectXTex:
+
+	if (params.soak && (params.threadSplit || params.scalingSweep || params.tune || params.estimate || params.abTest ||
+		params.mode == Parameters::Mode::Decompress || params.settings.pipelined))
 	{
-		auto mode = params.useGPU ?
-			DirectXTexCodec::Mode::CPU_GPU :
-			DirectXTexCodec::Mode::CPU_ONLY;
-		auto codec = std::make_unique<DirectXTexCodec>(mode);
-		codec->setBC7Quick(params.bc7Quick);
-		codec->setBC7Use3Subsets(params.bc7Use3Subsets);
-		return codec;
+		std::cerr << "--soak can't be combined with --threadsplit, --scalingsweep, --tune, --estimate, --ab, --mode decompress or --pipeline" << std::endl;
+		return false;
 	}
 
-	default:
-		return nullptr;
+	// Images are placed once for the workers of --threads, other thread counts would find them on the wrong nodes
+	if (params.settings.placement.numa != NumaPlacement::None && (params.scalingSweep || params.mode == Parameters::Mode::Decompress))
+	{
+		std::cerr << "--numa can't be combined with --scalingsweep or --mode decompress" << std::endl;
+		return false;
 	}
+
+	// Streamed images are loaded per pass, only pinning applies to them
+	if (params.settings.pipelined && params.settings.placement.numa != NumaPlacement::None)
+	{
+		std::cerr << "--numa can't be combined with --pipeline" << std::endl;
+		return false;
+	}
+
+	// Pipelined block times include loading the images, decompression moves bytes the other way
+	if (params.roofline && (params.mode == Parameters::Mode::Decompress || params.settings.pipelined))
+	{
+		std::cerr << "--roofline can't be combined with --mode decompress or --pipeline" << std::endl;
+		return false;
+	}
+
+	if (params.latency && (params.tune || params.estimate || params.abTest || params.soak || params.threadSplit || params.scalingSweep ||
+		params.cacheStates || params.settings.cacheState != CacheState::Loaded || params.mode == Parameters::Mode::Decompress || params.settings.pipelined))
+	{
+		std::cerr << "--latency can't be combined with other modes than compress, --cache or --pipeline" << std::endl;
+		return false;
+	}
+
+	// Only the passes over the data set loaded up front can be cut and extrapolated
+	// The budget holds for one measurement, modes measuring a configuration several times would multiply it
+	if (params.settings.timeBudgetSeconds > 0.0 && (params.tune || params.estimate || params.abTest || params.soak || params.latency ||
+		params.scalingSweep || params.threadSplit || params.cacheStates || params.mode == Parameters::Mode::Decompress || params.settings.pipelined))
+	{
+		std::cerr << "--timebudget can't be combined with --tune, --estimate, --ab, --soak, --latency, --scalingsweep, --threadsplit, --cache both, --mode decompress or --pipeline" << std::endl;
+		return false;
+	}
+
+	if (params.tune && (params.mode == Parameters::Mode::Decompress || params.settings.pipelined || params.scalingSweep))
+	{
+		std::cerr << "--tune can't be combined with --mode decompress, --pipeline or --scalingsweep" << std::endl;
+		return false;
+	}
+
+	if (params.estimate && (params.tune || params.mode == Parameters::Mode::Decompress || params.settings.pipelined || params.scalingSweep))
+	{
+		std::cerr << "--estimate can't be combined with --tune, --mode decompress, --pipeline or --scalingsweep" << std::endl;
+		return false;
+	}
+
+	if (params.abTest && (params.tune || params.estimate || params.mode == Parameters::Mode::Decompress || params.settings.pipelined || params.scalingSweep))
+	{
+		std::cerr << "--ab can't be combined with --tune, --estimate, --mode decompress, --pipeline or --scalingsweep" << std::endl;
+		return false;
+	}
+
+	// Allocations and the peak resident set are process-wide, concurrent images would count into each other's calls
+	if (params.settings.memoryStats && params.settings.threadCount > 1)
+	{
+		std::cerr << "--memorystats can't be combined with more than one thread, add --threads 1" << std::endl;
+		return false;
+	}
+
+	// The loader and verifier of a pipelined run would count into the calls of the single worker as well
+	if (params.settings.memoryStats && params.settings.pipelined)
+	{
+		std::cerr << "--memorystats can't be combined with --pipeline" << std::endl;
+		return false;
+	}
+
+	// Not an error, the codec may not have threads of its own, but its results say so as well
+	if (params.settings.perfCounters && params.settings.codecThreadCount != 1)
+	{
+		std::cerr << "--perfcounters only counts the calling threads, events of threads of the codec are missing unless --codecthreads is 1" << std::endl;
+	}
+
+	if (params.threadSplit && (parser.exists("codecthreads") || params.scalingSweep || params.tune || params.estimate || params.abTest ||
+		params.mode == Parameters::Mode::Decompress || params.settings.pipelined))
+	{
+		std::cerr << "--threadsplit can't be combined with --codecthreads, --scalingsweep, --tune, --estimate, --ab, --mode decompress or --pipeline" << std::endl;
+		return false;
+	}
+
+	if (params.mode == Parameters::Mode::Decompress && (params.settings.pipelined || params.scalingSweep))
+	{
+		std::cerr << "--mode decompress can't be combined with --pipeline or --scalingsweep" << std::endl;
+		return false;
+	}
+
+	if (parser.exists("memorybudget"))
+	{
+		auto budgetStr = parser.get<std::string>("memorybudget");
+		if (!parseBytes(budgetStr, params.settings.memoryBudgetBytes))
+		{
+			std::cerr << "Invalid memory budget " << budgetStr << std::endl;
+			return false;
+		}
+	}
+
+	if (parser.exists("warmup"))
+	{
+		params.settings.warmupRuns = parser.get<size_t>("warmup");
+	}
+
+	if (parser.exists("repetitions"))
+	{
+		params.settings.repetitions = parser.get<size_t>("repetitions");
+		if (params.settings.repetitions == 0)
+		{
+			std::cerr << "At least one repetition is required" << std::endl;
+			return false;
+		}
+	}
+
+	return true;
 }
+
 } // namespace
 
 int main(int argc, const char* argv[])
@@ -247,20 +745,250 @@ int main(int argc, const char* argv[])
 		return 1;
 	}
 
-	auto codec = makeCodec(params);
-	codec->setQuality(params.quality);
+	auto configs = expandMatrix(params.matrix);
+	if (params.abTest && configs.size() != 2)
+	{
+		std::cerr << "--ab needs exactly two configurations, got " << configs.size() << std::endl;
+		return 1;
+	}
+
+	if (!params.traceFile.empty())
+	{
+		startTracing();
+	}
+
+	if (params.settings.memoryStats)
+	{
+		enableAllocationCounting();
+	}
+
+	// Pipelined runs stream the data set once per configuration by design
+	DataSet dataSet;
+	if (!params.settings.pipelined)
+	{
+		auto start = Clock::now();
+		dataSet = loadDataSet(params.inputDir);
+		auto end = Clock::now();
+
+		size_t dataSetBytes = 0;
+		for (const auto& image : dataSet)
+		{
+			dataSetBytes += image.image.bytes.size();
+		}
+
+		std::cout << "Loaded " << dataSet.size() << " images (" << formatBytes(dataSetBytes) << ") in ";
+		std::cout << std::fixed << std::setprecision(2) << elapsedNanoseconds(start, end) * 1e-9 << " sec" << std::endl;
+
+		if (!placeDataSet(dataSet, params.settings.placement, params.settings.threadCount))
+		{
+			return 1;
+		}
+	}
+
+	// Before any codec runs, so that the kernels have the machine to themselves
+	std::unique_ptr<Roofline> roofline;
+	if (params.roofline)
+	{
+		roofline = std::make_unique<Roofline>(params.settings.threadCount);
+		printRooflinePeaks(std::cout, *roofline);
+	}
+
+	std::vector<ConfigurationResults> allResults;
+	auto tuneFailed = false;
+	for (auto format : params.tune ? params.matrix.formats : std::vector<CompressedFormat>())
+	{
+		std::vector<Configuration> candidates;
+		std::copy_if(std::begin(configs), std::end(configs), std::back_inserter(candidates),
+			[&](const Configuration& config) { return config.format == format; });
+
+		std::cout << std::endl << "Tuning " << toString(format) << " for error " << std::setprecision(5) << params.tuneSettings.maxError << std::endl;
+		auto result = tune(dataSet, candidates, params.tuneSettings, params.settings);
+		printTuneResult(std::cout, result, params.tuneSettings);
 
-	Benchmark benchmark(*codec);
-	auto results = benchmark.run(params.inputDir, params.format);
+		if (result.found)
+		{
+			allResults.push_back(std::move(result.best));
+		}
+		tuneFailed = tuneFailed || !result.found;
+	}
 
-	if (results.hasErrors)
+	if (params.abTest)
 	{
-		std::cout << "Benchmark completed with errors!" << std::endl;
+		std::cout << std::endl << "A/B " << describe(configs[0]) << " vs " << describe(configs[1]) << std::endl;
+		auto result = runAbTest(dataSet, configs[0], configs[1], params.abTestSettings, params.settings);
+		printAbTest(std::cout, result, params.abTestSettings, params.perImage);
+		allResults.push_back(std::move(result.a));
+		allResults.push_back(std::move(result.b));
 	}
 
-	std::cout << "Compressed in " << results.elapsedSeconds << " sec\t\t";
-	std::cout << "Throughput " << formatBytes(results.throughputBytesPerSec) << "/sec\t\t";
-	std::cout << "Error " << std::fixed << std::setprecision(5) << results.compressionError << std::endl;
+	// One-time initialization of a backend, or of CUDA, falls into the first configuration that uses it
+	std::set<std::pair<CodecType, bool>> constructedCodecs;
+	for (const auto& config : params.tune || params.abTest ? std::vector<Configuration>() : configs)
+	{
+		std::cout << std::endl << describe(config) << std::endl;
+
+		// Before any other codec of this configuration is constructed
+		if (params.latency)
+		{
+			if (dataSet.empty())
+			{
+				std::cerr << "No images in " << params.inputDir << std::endl;
+				return 1;
+			}
+
+			auto firstInProcess = constructedCodecs.insert({ config.codec, config.useGPU }).second;
+			auto results = measureLatency(config, dataSet.front(), firstInProcess, params.settings);
+			printLatency(std::cout, results);
+			allResults.push_back({ config, std::move(results) });
+			continue;
+		}
+
+		// Heatmaps of all configurations share the directory, file names carry the configuration
+		auto settings = params.settings;
+		settings.blockErrors.heatmapPrefix = describe(config);
+		std::replace(std::begin(settings.blockErrors.heatmapPrefix), std::end(settings.blockErrors.heatmapPrefix), ' ', '_');
+
+		auto codec = makeCodec(config);
+		Benchmark benchmark(*codec, settings);
+
+		if (params.mode == Parameters::Mode::Decompress)
+		{
+			auto variants = benchmark.runDecompression(dataSet, config.format);
+			printDecompressionResults(std::cout, variants, params.perImage);
+			allResults.push_back({ config, variants.back() });
+			continue;
+		}
+
+		if (params.estimate)
+		{
+			auto result = estimate(*codec, dataSet, config.format, params.estimateSettings, settings);
+			printEstimate(std::cout, result);
+			allResults.push_back({ config, toResults(result) });
+			continue;
+		}
+
+		if (params.soak)
+		{
+			std::vector<SoakSample> samples;
+			auto results = benchmark.runSoak(dataSet, config.format, params.soakSettings.durationSeconds, samples);
+			printResults(std::cout, results, params.perImage);
+
+			auto report = analyzeSoak(samples, params.soakSettings);
+			printSoakReport(std::cout, samples, report);
+			if (!params.soakSettings.chartDir.empty() && !writeSoakChart(params.soakSettings.chartDir, describe(config), samples, report))
+			{
+				std::cerr << "Failed to write the soak chart to " << params.soakSettings.chartDir << std::endl;
+			}
+
+			allResults.push_back({ config, std::move(results) });
+			continue;
+		}
+
+		if (params.threadSplit)
+		{
+			auto groups = benchmark.runThreadSplits(dataSet, config.format);
+			printThreadSplits(std::cout, groups);
+			const auto& splits = groups.front().splits;
+			allResults.push_back({ config, splits[bestThreadSplit(splits)] });
+			continue;
+		}
+
+		if (params.scalingSweep)
+		{
+			auto sweep = benchmark.runScalingSweep(dataSet, config.format);
+			printScalingSweep(std::cout, sweep);
+			allResults.push_back({ config, sweep.back() });
+			continue;
+		}
+
+		// Production encodes start from freshly read data, so the cold results stand for the configuration
+		if (params.cacheStates)
+		{
+			auto states = benchmark.runCacheStates(dataSet, config.format);
+			printCacheStates(std::cout, states, params.perImage);
+			allResults.push_back({ config, states.front() });
+			continue;
+		}
+
+		auto results = params.settings.pipelined ?
+			benchmark.run(params.inputDir, config.format) :
+			benchmark.run(dataSet, config.format);
+
+		printResults(std::cout, results, params.perImage);
+		allResults.push_back({ config, std::move(results) });
+	}
+
+	if (allResults.size() > 1)
+	{
+		std::cout << std::endl;
+		printSummary(std::cout, allResults);
+	}
+
+	if (params.pareto)
+	{
+		auto fronts = computeParetoFronts(allResults, params.paretoMetric);
+		printParetoFronts(std::cout, fronts, allResults, params.paretoMetric);
+
+		if (!params.paretoDir.empty() && !writeParetoFronts(params.paretoDir, fronts, allResults, params.paretoMetric))
+		{
+			std::cerr << "Failed to write Pareto frontiers to " << params.paretoDir << std::endl;
+			return 1;
+		}
+	}
+
+	if (roofline)
+	{
+		printRoofline(std::cout, placeOnRoofline(*roofline, allResults), allResults);
+	}
+
+	if (!params.traceFile.empty() && !writeTrace(params.traceFile))
+	{
+		std::cerr << "Failed to write trace " << params.traceFile << std::endl;
+		return 1;
+	}
+
+	RunDescription run;
+	run.inputDir = params.inputDir;
+	run.mode = params.mode == Parameters::Mode::Decompress ? "decompress" : params.tune ? "tune" : params.estimate ? "estimate" :
+		params.abTest ? "ab" : params.latency ? "latency" : params.soak ? "soak" : params.threadSplit ? "threadsplit" :
+		params.scalingSweep ? "scalingsweep" : params.cacheStates ? "cachestates" : "compress";
+	run.settings = params.settings;
+	if (params.cacheStates)
+	{
+		run.settings.cacheState = CacheState::Cold;
+	}
+
+	if (!params.jsonFile.empty() && !writeJsonResults(params.jsonFile, run, allResults))
+	{
+		std::cerr << "Failed to write " << params.jsonFile << std::endl;
+		return 1;
+	}
+
+	if (!params.csvFile.empty() && !writeCsvResults(params.csvFile, allResults))
+	{
+		std::cerr << "Failed to write " << params.csvFile << std::endl;
+		return 1;
+	}
+
+	if (tuneFailed)
+	{
+		return 1;
+	}
+
+	if (!params.baselineFile.empty())
+	{
+		size_t regressionCount = 0;
+		if (!compareWithBaseline(std::cout, params.baselineFile, run, allResults, params.thresholds, regressionCount))
+		{
+			return 1;
+		}
+
+		if (regressionCount > 0)
+		{
+			std::cout << regressionCount << " regression(s) against the baseline" << std::endl;
+			return 2;
+		}
+	}
 
 	return 0;
-}
\ No newline at end of file
+}
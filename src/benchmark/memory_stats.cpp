@@ -0,0 +1,301 @@
+#include "memory_stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fstream>
+#include <string>
+#endif
+
+namespace
+{
+// Allocations of one thread, written by that thread only and summed up by readers.
+// Threads link themselves into a list on their first counted allocation.
+struct ThreadAllocations
+{
+	std::atomic<uint64_t> count = 0;
+	std::atomic<uint64_t> bytes = 0;
+	ThreadAllocations* next = nullptr;
+
+	ThreadAllocations();
+	~ThreadAllocations();
+};
+
+std::atomic<bool> countingEnabled = false;
+
+std::mutex threadsMutex;
+ThreadAllocations* threads = nullptr;
+// Totals of the threads that have exited
+uint64_t exitedAllocationCount = 0;
+uint64_t exitedAllocatedBytes = 0;
+
+ThreadAllocations::ThreadAllocations()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	next = threads;
+	threads = this;
+}
+
+ThreadAllocations::~ThreadAllocations()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	exitedAllocationCount += count.load(std::memory_order_relaxed);
+	exitedAllocatedBytes += bytes.load(std::memory_order_relaxed);
+
+	auto link = &threads;
+	while (*link != this)
+	{
+		link = &(*link)->next;
+	}
+	*link = next;
+}
+
+// No locked instruction and no shared cache line per allocation, and nothing at all without --memorystats
+void countAllocation(std::size_t size)
+{
+	if (!countingEnabled.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	thread_local ThreadAllocations allocations;
+	allocations.count.store(allocations.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	allocations.bytes.store(allocations.bytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+}
+
+void* allocate(std::size_t size)
+{
+	countAllocation(size);
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+	countAllocation(size);
+
+	auto align = static_cast<std::size_t>(alignment);
+#if defined(_MSC_VER)
+	return _aligned_malloc(size > 0 ? size : 1, align);
+#else
+	// aligned_alloc wants the size to be a multiple of the alignment
+	return std::aligned_alloc(align, std::max<std::size_t>((size + align - 1) / align * align, align));
+#endif
+}
+
+void freeAligned(void* pointer)
+{
+#if defined(_MSC_VER)
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+#if defined(_WIN32)
+size_t residentSetBytes()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+}
+
+size_t peakResidentSetBytes()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+}
+
+void resetPeakResidentSet()
+{
+}
+#else
+// Reads a "Name:   1234 kB" line of /proc/self/status
+size_t readStatusBytes(const std::string& field)
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, field.size(), field) == 0 && line.size() > field.size() && line[field.size()] == ':')
+		{
+			return static_cast<size_t>(std::strtoull(line.c_str() + field.size() + 1, nullptr, 10)) * 1024;
+		}
+	}
+
+	return 0;
+}
+
+size_t residentSetBytes()
+{
+	return readStatusBytes("VmRSS");
+}
+
+size_t peakResidentSetBytes()
+{
+	return readStatusBytes("VmHWM");
+}
+
+// Writing 5 to clear_refs resets VmHWM to the current resident set
+void resetPeakResidentSet()
+{
+	std::ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5";
+}
+#endif
+} // namespace
+
+size_t currentResidentSetBytes()
+{
+	return residentSetBytes();
+}
+
+// Replacements of the global allocation functions. Only allocations made through this
+// executable's operator new are counted, codecs calling malloc directly or allocating
+// inside their own DLL with a separate runtime are not.
+void* operator new(std::size_t size)
+{
+	if (auto pointer = allocate(size))
+	{
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	if (auto pointer = allocate(size))
+	{
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (auto pointer = allocateAligned(size, alignment))
+	{
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	if (auto pointer = allocateAligned(size, alignment))
+	{
+		return pointer;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(pointer); }
+
+void MemoryUsage::addRepetition(const MemoryUsage& other)
+{
+	peakResidentSetBytes = std::max(peakResidentSetBytes, other.peakResidentSetBytes);
+	residentSetGrowthBytes = std::max(residentSetGrowthBytes, other.residentSetGrowthBytes);
+	allocationCount = std::max(allocationCount, other.allocationCount);
+	allocatedBytes = std::max(allocatedBytes, other.allocatedBytes);
+	measurements += other.measurements;
+}
+
+void MemoryUsage::addSequential(const MemoryUsage& other)
+{
+	peakResidentSetBytes = std::max(peakResidentSetBytes, other.peakResidentSetBytes);
+	residentSetGrowthBytes = std::max(residentSetGrowthBytes, other.residentSetGrowthBytes);
+	allocationCount += other.allocationCount;
+	allocatedBytes += other.allocatedBytes;
+	measurements += other.measurements;
+}
+
+void enableAllocationCounting()
+{
+	countingEnabled.store(true, std::memory_order_relaxed);
+}
+
+uint64_t allocationCount()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	auto result = exitedAllocationCount;
+	for (auto thread = threads; thread != nullptr; thread = thread->next)
+	{
+		result += thread->count.load(std::memory_order_relaxed);
+	}
+
+	return result;
+}
+
+uint64_t allocatedBytes()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	auto result = exitedAllocatedBytes;
+	for (auto thread = threads; thread != nullptr; thread = thread->next)
+	{
+		result += thread->bytes.load(std::memory_order_relaxed);
+	}
+
+	return result;
+}
+
+void MemoryMeasurement::start()
+{
+	resetPeakResidentSet();
+	m_startResidentSetBytes = residentSetBytes();
+	m_startAllocationCount = allocationCount();
+	m_startAllocatedBytes = allocatedBytes();
+}
+
+void MemoryMeasurement::stop(MemoryUsage& usage)
+{
+	MemoryUsage measurement;
+	measurement.measurements = 1;
+	measurement.allocationCount = allocationCount() - m_startAllocationCount;
+	measurement.allocatedBytes = allocatedBytes() - m_startAllocatedBytes;
+	measurement.peakResidentSetBytes = peakResidentSetBytes();
+	measurement.residentSetGrowthBytes = measurement.peakResidentSetBytes > m_startResidentSetBytes ?
+		measurement.peakResidentSetBytes - m_startResidentSetBytes : 0;
+
+	usage.addRepetition(measurement);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Memory used by one codec call, or the combination of several
+struct MemoryUsage
+{
+	size_t measurements = 0;
+	// Process peak resident set during the call, and its growth over the resident set at the start
+	size_t peakResidentSetBytes = 0;
+	size_t residentSetGrowthBytes = 0;
+	// Global operator new calls and the bytes they requested
+	uint64_t allocationCount = 0;
+	uint64_t allocatedBytes = 0;
+
+	// Repeated calls on the same data: keeps the worst of each value
+	void addRepetition(const MemoryUsage& other);
+	// Calls on different data, e.g. all images of a pass: peaks are maxed, allocations summed
+	void addSequential(const MemoryUsage& other);
+};
+
+// Current resident set of the process
+size_t currentResidentSetBytes();
+
+// Allocations are only counted from here on, the operator new replacement costs a flag check otherwise
+void enableAllocationCounting();
+
+// Process-wide allocation totals since counting was enabled, counted by the global operator new replacement
+uint64_t allocationCount();
+uint64_t allocatedBytes();
+
+// Measures the calls between start() and stop(). Everything is process-wide, so codec worker
+// threads are included, and so is any other work running concurrently, which is why --memorystats
+// takes a single benchmark thread and isn't available with --pipeline.
+// The peak resident set comes from VmHWM in /proc/self/status, reset through /proc/self/clear_refs
+// before every call. On Windows the peak working set can't be reset and only grows.
+class MemoryMeasurement final
+{
+public:
+	void start();
+	void stop(MemoryUsage& usage);
+
+private:
+	size_t m_startResidentSetBytes = 0;
+	uint64_t m_startAllocationCount = 0;
+	uint64_t m_startAllocatedBytes = 0;
+};
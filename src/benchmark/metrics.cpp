@@ -0,0 +1,390 @@
+#include "metrics.hpp"
+#include "parallel.hpp"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+const size_t WindowSize = 11;
+const double WindowSigma = 1.5;
+
+// Stabilizing constants for a dynamic range of 255
+const float C1 = (0.01f * 255.f) * (0.01f * 255.f);
+const float C2 = (0.03f * 255.f) * (0.03f * 255.f);
+
+// Weights of the five scales from Wang, Simoncelli and Bovik, "Multi-scale structural similarity"
+const double MsssimWeights[] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+const size_t MsssimScaleCount = sizeof(MsssimWeights) / sizeof(MsssimWeights[0]);
+
+// Output rows per work item, the horizontal pass of a band needs WindowSize - 1 extra rows
+const size_t BandRows = 32;
+
+// Blurred moments needed by SSIM: E[x], E[y], E[x^2], E[y^2], E[xy]
+const size_t MomentCount = 5;
+
+// The four channels of a pixel share one __m128, pixels themselves are processed one at a time.
+// MS-SSIM scale s of an image averages blocks of 2^s x 2^s pixels, which gives the same values as
+// halving it s times. Rows are converted from the RGBA8 data when a band needs them, so no float
+// copy of a whole image or of its downsampled scales is ever made.
+struct ScaledImage
+{
+	const UncompressedImage* image;
+	size_t scale;
+	size_t width;
+	size_t height;
+
+	ScaledImage(const UncompressedImage& source, size_t scale)
+		: image(&source)
+		, scale(scale)
+		, width(source.width >> scale)
+		, height(source.height >> scale)
+	{}
+
+	void loadRow(size_t y, __m128* out) const
+	{
+		auto blockSize = size_t(1) << scale;
+		auto normalization = _mm_set1_ps(1.f / static_cast<float>(blockSize * blockSize));
+		for (size_t x = 0; x < width; ++x)
+		{
+			// At most 256 bytes per sum for the five scales, exact in integers and in float
+			uint32_t sums[4] = {};
+			for (size_t dy = 0; dy < blockSize; ++dy)
+			{
+				const auto* bytes = image->bytes.data() + ((y * blockSize + dy) * image->width + x * blockSize) * 4;
+				for (size_t dx = 0; dx < blockSize * 4; dx += 4)
+				{
+					sums[0] += bytes[dx + 0];
+					sums[1] += bytes[dx + 1];
+					sums[2] += bytes[dx + 2];
+					sums[3] += bytes[dx + 3];
+				}
+			}
+
+			out[x] = _mm_mul_ps(_mm_setr_ps(
+				static_cast<float>(sums[0]), static_cast<float>(sums[1]),
+				static_cast<float>(sums[2]), static_cast<float>(sums[3])), normalization);
+		}
+	}
+};
+
+struct SsimSums
+{
+	double ssim[4] = {};
+	double cs[4] = {};
+	uint64_t count = 0;
+};
+
+const float* gaussianWindow()
+{
+	static const auto window = []()
+	{
+		std::vector<float> weights(WindowSize);
+		double sum = 0.0;
+		for (size_t i = 0; i < WindowSize; ++i)
+		{
+			auto x = static_cast<double>(i) - static_cast<double>(WindowSize / 2);
+			weights[i] = static_cast<float>(std::exp(-x * x / (2.0 * WindowSigma * WindowSigma)));
+			sum += weights[i];
+		}
+
+		for (auto& weight : weights)
+		{
+			weight = static_cast<float>(weight / sum);
+		}
+
+		return weights;
+	}();
+
+	return window.data();
+}
+
+void addToSums(double sums[4], __m128 value)
+{
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, value);
+	for (size_t channel = 0; channel < 4; ++channel)
+	{
+		sums[channel] += lanes[channel];
+	}
+}
+
+// Sums SSIM and its contrast-structure term over all valid window positions.
+// Bands of output rows are distributed over threads, each band does a horizontal
+// pass over rows converted on the fly into a small buffer of moments followed by a vertical pass.
+SsimSums computeSsimSums(const ScaledImage& image0, const ScaledImage& image1, size_t threadCount)
+{
+	SsimSums total;
+	if (image0.width < WindowSize || image0.height < WindowSize)
+	{
+		return total;
+	}
+
+	const auto* window = gaussianWindow();
+	auto outWidth = image0.width - WindowSize + 1;
+	auto outHeight = image0.height - WindowSize + 1;
+	auto bandCount = (outHeight + BandRows - 1) / BandRows;
+
+	std::mutex mutex;
+	WorkQueue queue(bandCount);
+	runOnThreads(std::min(threadCount, bandCount), [&](size_t)
+	{
+		SsimSums local;
+		auto fieldSize = (BandRows + WindowSize - 1) * outWidth;
+		std::vector<__m128> moments(MomentCount * fieldSize);
+		std::vector<__m128> row0(image0.width);
+		std::vector<__m128> row1(image0.width);
+
+		size_t band;
+		while (queue.pop(band))
+		{
+			auto y0 = band * BandRows;
+			auto y1 = std::min(y0 + BandRows, outHeight);
+			auto inputRows = y1 - y0 + WindowSize - 1;
+
+			for (size_t r = 0; r < inputRows; ++r)
+			{
+				image0.loadRow(y0 + r, row0.data());
+				image1.loadRow(y0 + r, row1.data());
+				auto* out = moments.data() + r * outWidth;
+				for (size_t x = 0; x < outWidth; ++x)
+				{
+					auto mx = _mm_setzero_ps();
+					auto my = _mm_setzero_ps();
+					auto mxx = _mm_setzero_ps();
+					auto myy = _mm_setzero_ps();
+					auto mxy = _mm_setzero_ps();
+					for (size_t k = 0; k < WindowSize; ++k)
+					{
+						auto w = _mm_set1_ps(window[k]);
+						auto a = row0[x + k];
+						auto b = row1[x + k];
+						auto wa = _mm_mul_ps(w, a);
+						auto wb = _mm_mul_ps(w, b);
+						mx = _mm_add_ps(mx, wa);
+						my = _mm_add_ps(my, wb);
+						mxx = _mm_add_ps(mxx, _mm_mul_ps(wa, a));
+						myy = _mm_add_ps(myy, _mm_mul_ps(wb, b));
+						mxy = _mm_add_ps(mxy, _mm_mul_ps(wa, b));
+					}
+
+					out[x] = mx;
+					out[x + fieldSize] = my;
+					out[x + fieldSize * 2] = mxx;
+					out[x + fieldSize * 3] = myy;
+					out[x + fieldSize * 4] = mxy;
+				}
+			}
+
+			auto c1 = _mm_set1_ps(C1);
+			auto c2 = _mm_set1_ps(C2);
+			auto two = _mm_set1_ps(2.f);
+			for (size_t r = 0; r < y1 - y0; ++r)
+			{
+				auto rowSsim = _mm_setzero_ps();
+				auto rowCs = _mm_setzero_ps();
+				for (size_t x = 0; x < outWidth; ++x)
+				{
+					__m128 m[MomentCount];
+					for (size_t f = 0; f < MomentCount; ++f)
+					{
+						const auto* field = moments.data() + f * fieldSize + r * outWidth + x;
+						auto sum = _mm_setzero_ps();
+						for (size_t k = 0; k < WindowSize; ++k)
+						{
+							sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(window[k]), field[k * outWidth]));
+						}
+						m[f] = sum;
+					}
+
+					auto mx2 = _mm_mul_ps(m[0], m[0]);
+					auto my2 = _mm_mul_ps(m[1], m[1]);
+					auto mxy = _mm_mul_ps(m[0], m[1]);
+					auto sxx = _mm_sub_ps(m[2], mx2);
+					auto syy = _mm_sub_ps(m[3], my2);
+					auto sxy = _mm_sub_ps(m[4], mxy);
+
+					auto cs = _mm_div_ps(
+						_mm_add_ps(_mm_mul_ps(two, sxy), c2),
+						_mm_add_ps(_mm_add_ps(sxx, syy), c2));
+					auto luminance = _mm_div_ps(
+						_mm_add_ps(_mm_mul_ps(two, mxy), c1),
+						_mm_add_ps(_mm_add_ps(mx2, my2), c1));
+
+					rowSsim = _mm_add_ps(rowSsim, _mm_mul_ps(luminance, cs));
+					rowCs = _mm_add_ps(rowCs, cs);
+				}
+
+				// Rows are summed in float and then promoted, which keeps precision on 8k images
+				addToSums(local.ssim, rowSsim);
+				addToSums(local.cs, rowCs);
+			}
+
+			local.count += (y1 - y0) * outWidth;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			total.ssim[channel] += local.ssim[channel];
+			total.cs[channel] += local.cs[channel];
+		}
+		total.count += local.count;
+	});
+
+	return total;
+}
+
+// Images too small for all five scales use the scales that fit the window, with renormalized weights
+void computeMsssim(const UncompressedImage& reference, const UncompressedImage& image, size_t threadCount, double result[4])
+{
+	double logSums[4] = {};
+	double weightSum = 0.0;
+	bool collapsed[4] = {};
+
+	for (size_t scale = 0; scale < MsssimScaleCount; ++scale)
+	{
+		ScaledImage image0(reference, scale);
+		ScaledImage image1(image, scale);
+		auto sums = computeSsimSums(image0, image1, threadCount);
+		if (sums.count == 0)
+		{
+			break;
+		}
+
+		auto isLast = scale + 1 == MsssimScaleCount ||
+			std::min(image0.width, image0.height) / 2 < WindowSize;
+
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			auto value = (isLast ? sums.ssim[channel] : sums.cs[channel]) / sums.count;
+			if (value <= 0.0)
+			{
+				collapsed[channel] = true;
+			}
+			else
+			{
+				logSums[channel] += MsssimWeights[scale] * std::log(value);
+			}
+		}
+		weightSum += MsssimWeights[scale];
+
+		if (isLast)
+		{
+			break;
+		}
+	}
+
+	for (size_t channel = 0; channel < 4; ++channel)
+	{
+		result[channel] = (weightSum == 0.0 || collapsed[channel]) ? 0.0 : std::exp(logSums[channel] / weightSum);
+	}
+}
+
+void accumulateSquaredErrors(const UncompressedImage& image0, const UncompressedImage& image1, size_t threadCount, uint64_t sums[4])
+{
+	std::mutex mutex;
+	parallelFor(image0.height, threadCount, [&](size_t begin, size_t end)
+	{
+		uint64_t local[4] = {};
+		for (size_t y = begin; y < end; ++y)
+		{
+			const auto* bytes0 = image0.bytes.data() + y * image0.width * 4;
+			const auto* bytes1 = image1.bytes.data() + y * image0.width * 4;
+			for (size_t x = 0; x < image0.width * 4; x += 4)
+			{
+				for (size_t channel = 0; channel < 4; ++channel)
+				{
+					auto error = static_cast<int>(bytes0[x + channel]) - static_cast<int>(bytes1[x + channel]);
+					local[channel] += static_cast<uint64_t>(error * error);
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			sums[channel] += local[channel];
+		}
+	});
+}
+} // namespace
+
+MetricsCalculator::MetricsCalculator(const MetricSelection& selection, size_t relevantChannels, size_t threadCount)
+	: m_selection(selection)
+	, m_relevantChannels(relevantChannels)
+	, m_threadCount(std::max<size_t>(threadCount, 1))
+{
+}
+
+void MetricsCalculator::addImage(const UncompressedImage& reference, const UncompressedImage& image)
+{
+	if (m_selection.psnr)
+	{
+		accumulateSquaredErrors(reference, image, m_threadCount, m_squaredErrorSums);
+		m_pixelCount += reference.width * reference.height;
+	}
+
+	if (!m_selection.ssim && !m_selection.msssim)
+	{
+		return;
+	}
+
+	if (m_selection.ssim)
+	{
+		auto sums = computeSsimSums(ScaledImage(reference, 0), ScaledImage(image, 0), m_threadCount);
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			m_ssimSums[channel] += sums.ssim[channel];
+		}
+		m_ssimCount += sums.count;
+	}
+
+	if (m_selection.msssim)
+	{
+		double values[4];
+		computeMsssim(reference, image, m_threadCount, values);
+
+		auto weight = reference.width * reference.height;
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			m_msssimSums[channel] += values[channel] * weight;
+		}
+		m_msssimWeight += weight;
+	}
+}
+
+QualityMetrics MetricsCalculator::calculate() const
+{
+	QualityMetrics result;
+	result.computed = m_selection;
+	result.channelCount = m_relevantChannels;
+
+	for (size_t channel = 0; channel < 4; ++channel)
+	{
+		if (m_pixelCount > 0)
+		{
+			auto mse = static_cast<double>(m_squaredErrorSums[channel]) / static_cast<double>(m_pixelCount);
+			result.psnr[channel] = mse > 0.0 ?
+				10.0 * std::log10(255.0 * 255.0 / mse) :
+				std::numeric_limits<double>::infinity();
+		}
+
+		if (m_ssimCount > 0)
+		{
+			result.ssim[channel] = m_ssimSums[channel] / static_cast<double>(m_ssimCount);
+		}
+
+		if (m_msssimWeight > 0)
+		{
+			result.msssim[channel] = m_msssimSums[channel] / static_cast<double>(m_msssimWeight);
+		}
+	}
+
+	return result;
+}
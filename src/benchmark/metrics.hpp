@@ -0,0 +1,52 @@
+#pragma once
+
+#include "codec.hpp"
+
+#include <cstdint>
+
+struct MetricSelection
+{
+	bool psnr = false;
+	bool ssim = false;
+	bool msssim = false;
+
+	bool any() const { return psnr || ssim || msssim; }
+};
+
+// Values are given per RGBA channel, only the first channelCount ones are meaningful
+struct QualityMetrics
+{
+	MetricSelection computed;
+	size_t channelCount = 0;
+	double psnr[4] = {};
+	double ssim[4] = {};
+	double msssim[4] = {};
+};
+
+// Accumulates full-reference quality metrics over a number of image pairs.
+// PSNR is computed from the MSE pooled over all images, SSIM is the mean over all
+// window positions and MS-SSIM is the per-image value weighted by pixel count.
+// SSIM uses the usual 11x11 Gaussian window with sigma 1.5 over the valid region only.
+class MetricsCalculator final
+{
+public:
+	MetricsCalculator(const MetricSelection& selection, size_t relevantChannels, size_t threadCount = 1);
+
+	void addImage(const UncompressedImage& reference, const UncompressedImage& image);
+
+	QualityMetrics calculate() const;
+
+private:
+	const MetricSelection m_selection;
+	const size_t m_relevantChannels;
+	const size_t m_threadCount;
+
+	uint64_t m_squaredErrorSums[4] = {};
+	uint64_t m_pixelCount = 0;
+
+	double m_ssimSums[4] = {};
+	uint64_t m_ssimCount = 0;
+
+	double m_msssimSums[4] = {};
+	uint64_t m_msssimWeight = 0;
+};
@@ -1,4 +1,5 @@
 #include "nvtt_codec.hpp"
+#include "parallel.hpp"
 
 #include <nvtt.h>
 
@@ -30,6 +31,26 @@ std::vector<unsigned char> rgbaToGbra(std::vector<unsigned char> bytes)
 
 	return bytes;
 }
+
+// Runs the tasks of one call on a fixed number of threads, the calling thread included,
+// the others come from the pool of the codec so that no dispatch starts threads of its own
+class FixedThreadDispatcher final : public nvtt::TaskDispatcher
+{
+public:
+	FixedThreadDispatcher(ThreadPool& pool, size_t threadCount) : m_pool(pool), m_threadCount(threadCount) {}
+
+	void dispatch(nvtt::Task* task, void* context, int count) override
+	{
+		m_pool.run(static_cast<size_t>(count), m_threadCount - 1, [&](size_t i)
+		{
+			task(context, static_cast<int>(i));
+		});
+	}
+
+private:
+	ThreadPool& m_pool;
+	const size_t m_threadCount;
+};
 } // namespace
 
 bool NvttCodec::doCompress(const UncompressedImage& input, CompressedFormat format, CompressedImage& output)
@@ -100,6 +121,12 @@ bool NvttCodec::doCompress(const UncompressedImage& input, CompressedFormat form
 	nvtt::Compressor compressor;
 	compressor.enableCudaAcceleration(m_cudaEnabled);
 
+	FixedThreadDispatcher dispatcher(m_pool, std::max<size_t>(threadCount(), 1));
+	if (threadCount() > 0)
+	{
+		compressor.setTaskDispatcher(&dispatcher);
+	}
+
 	auto estimated = compressor.estimateSize(inputOptions, compressionOptions);
 	outputHandler.bytes.reserve(static_cast<size_t>(estimated));
 
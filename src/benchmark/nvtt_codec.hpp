@@ -1,6 +1,7 @@
 #pragma once
 
 #include "codec.hpp"
+#include "parallel.hpp"
 
 class NvttCodec final : public Codec
 {
@@ -13,4 +14,6 @@ private:
 
 private:
 	bool m_cudaEnabled = false;
+	// Helpers of the task dispatcher when threadCount() is set, shared by concurrent calls
+	ThreadPool m_pool;
 };
\ No newline at end of file
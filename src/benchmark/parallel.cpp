@@ -0,0 +1,242 @@
+#include "parallel.hpp"
+
+#include <cmath>
+#include <limits>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+
+#include <fstream>
+#include <string>
+#endif
+
+namespace
+{
+#if defined(_WIN32)
+// CPUs worth of time a hard capped job object allows, 0 without a cap
+double cpuQuota(size_t cpuCount)
+{
+	JOBOBJECT_CPU_RATE_CONTROL_INFORMATION info = {};
+	if (!QueryInformationJobObject(nullptr, JobObjectCpuRateControlInformation, &info, sizeof(info), nullptr))
+	{
+		return 0.0;
+	}
+
+	const DWORD hardCap = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+	if ((info.ControlFlags & hardCap) != hardCap)
+	{
+		return 0.0;
+	}
+
+	// The rate is in 1/100 of a percent of all processors
+	return info.CpuRate / 10000.0 * cpuCount;
+}
+
+size_t affinityCpuCount()
+{
+	return std::numeric_limits<size_t>::max();
+}
+#elif defined(__linux__)
+// cgroup v2 "max 100000" or "200000 100000", v1 keeps quota and period in two files with -1 for no quota
+double readQuota(const std::string& dir)
+{
+	std::ifstream max(dir + "/cpu.max");
+	std::string quota;
+	double period;
+	if (max >> quota >> period)
+	{
+		return quota != "max" && period > 0.0 ? std::stod(quota) / period : 0.0;
+	}
+
+	std::ifstream quotaIn(dir + "/cpu.cfs_quota_us");
+	std::ifstream periodIn(dir + "/cpu.cfs_period_us");
+	double quotaMicroseconds;
+	if (quotaIn >> quotaMicroseconds && periodIn >> period && quotaMicroseconds > 0.0 && period > 0.0)
+	{
+		return quotaMicroseconds / period;
+	}
+
+	return 0.0;
+}
+
+// Tightest quota of the process's cgroup and its ancestors, 0 without a quota
+double cpuQuota(size_t)
+{
+	std::ifstream cgroups("/proc/self/cgroup");
+	std::string line;
+	std::string root;
+	std::string path;
+	while (std::getline(cgroups, line))
+	{
+		// hierarchy-ID:controllers:path, the v2 entry has no controllers
+		auto first = line.find(':');
+		auto second = line.find(':', first + 1);
+		if (first == std::string::npos || second == std::string::npos)
+		{
+			continue;
+		}
+
+		auto controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+		if (controllers == ",,")
+		{
+			root = "/sys/fs/cgroup";
+			path = line.substr(second + 1);
+		}
+		else if (controllers.find(",cpu,") != std::string::npos)
+		{
+			root = "/sys/fs/cgroup/cpu";
+			path = line.substr(second + 1);
+			break;
+		}
+	}
+
+	if (root.empty())
+	{
+		return 0.0;
+	}
+
+	// Inside a container the group shows up as / and its limits are on the mount root
+	auto quota = 0.0;
+	while (true)
+	{
+		auto groupQuota = readQuota(root + (path == "/" ? "" : path));
+		if (groupQuota > 0.0 && (quota == 0.0 || groupQuota < quota))
+		{
+			quota = groupQuota;
+		}
+
+		if (path.empty() || path == "/")
+		{
+			break;
+		}
+		path = path.substr(0, path.find_last_of('/'));
+		path = path.empty() ? "/" : path;
+	}
+
+	return quota;
+}
+
+size_t affinityCpuCount()
+{
+	cpu_set_t mask;
+	return sched_getaffinity(0, sizeof(mask), &mask) == 0 ? CPU_COUNT(&mask) : std::numeric_limits<size_t>::max();
+}
+#else
+double cpuQuota(size_t)
+{
+	return 0.0;
+}
+
+size_t affinityCpuCount()
+{
+	return std::numeric_limits<size_t>::max();
+}
+#endif
+
+size_t availableCpuCount()
+{
+	size_t count = std::thread::hardware_concurrency();
+	count = std::min(count > 0 ? count : 1, affinityCpuCount());
+
+	// A fractional quota still runs on one more CPU part of the time
+	auto quota = cpuQuota(count);
+	if (quota > 0.0)
+	{
+		count = std::min(count, static_cast<size_t>(std::ceil(quota)));
+	}
+
+	return std::max<size_t>(count, 1);
+}
+} // namespace
+
+size_t hardwareThreadCount()
+{
+	// Neither the quota nor the affinity of the process change during a run
+	static const size_t count = availableCpuCount();
+	return count;
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobAdded.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::run(size_t count, size_t helperCount, const std::function<void(size_t)>& task)
+{
+	WorkQueue queue(count);
+	auto helpers = std::min(helperCount, count > 0 ? count - 1 : 0);
+	Job job = { &task, &queue, helpers, 0 };
+
+	if (helpers > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (m_idleThreads < job.helpersWanted)
+		{
+			m_threads.emplace_back([this]() { work(); });
+			++m_idleThreads;
+		}
+
+		m_jobs.push_back(&job);
+		m_jobAdded.notify_all();
+	}
+
+	size_t index;
+	while (queue.pop(index))
+	{
+		task(index);
+	}
+
+	if (helpers > 0)
+	{
+		// Helpers that haven't joined by now would find nothing left, the job goes before its queue does
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobs.erase(std::remove(std::begin(m_jobs), std::end(m_jobs), &job), std::end(m_jobs));
+		m_helperDone.wait(lock, [&]() { return job.helpersWorking == 0; });
+	}
+}
+
+void ThreadPool::work()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_jobAdded.wait(lock, [&]() { return m_stopping || !m_jobs.empty(); });
+		if (m_stopping)
+		{
+			return;
+		}
+
+		auto job = m_jobs.front();
+		if (--job->helpersWanted == 0)
+		{
+			m_jobs.pop_front();
+		}
+		++job->helpersWorking;
+		--m_idleThreads;
+
+		lock.unlock();
+		size_t index;
+		while (job->queue->pop(index))
+		{
+			(*job->task)(index);
+		}
+		lock.lock();
+
+		++m_idleThreads;
+		if (--job->helpersWorking == 0)
+		{
+			m_helperDone.notify_all();
+		}
+	}
+}
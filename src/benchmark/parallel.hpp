@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Lock-free queue of item indices shared by a group of worker threads
+class WorkQueue final
+{
+public:
+	WorkQueue(size_t size) : m_size(size) {}
+
+	bool pop(size_t& index)
+	{
+		index = m_next.fetch_add(1, std::memory_order_relaxed);
+		return index < m_size;
+	}
+
+private:
+	std::atomic<size_t> m_next = 0;
+	const size_t m_size;
+};
+
+// Hands items threadIndex, threadIndex + threadCount... to one thread, so that an item always goes to the same thread
+class StridedQueue final
+{
+public:
+	StridedQueue(size_t size, size_t threadIndex, size_t threadCount) : m_size(size), m_next(threadIndex), m_stride(threadCount) {}
+
+	bool pop(size_t& index)
+	{
+		index = m_next;
+		m_next += m_stride;
+		return index < m_size;
+	}
+
+private:
+	const size_t m_size;
+	size_t m_next;
+	const size_t m_stride;
+};
+
+// Hardware threads the process may use, capped by its CPU affinity and its cgroup or job object CPU quota
+size_t hardwareThreadCount();
+
+// Calls worker(threadIndex) on threadCount threads and waits for all of them.
+// The calling thread runs the worker with index 0.
+template <typename Worker>
+void runOnThreads(size_t threadCount, Worker&& worker)
+{
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount > 1 ? threadCount - 1 : 0);
+	for (size_t i = 1; i < threadCount; ++i)
+	{
+		threads.emplace_back([&worker, i]() { worker(i); });
+	}
+
+	worker(size_t(0));
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+// Threads kept across calls that help the callers of run() with their tasks. Several callers may run at
+// the same time, each with helpers of its own, the pool grows to the largest number of helpers needed at once.
+class ThreadPool final
+{
+public:
+	ThreadPool() = default;
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Calls task(index) for every index in [0, count) on the calling thread and up to helperCount
+	// threads of the pool, and returns once all of them are done
+	void run(size_t count, size_t helperCount, const std::function<void(size_t)>& task);
+
+private:
+	struct Job
+	{
+		const std::function<void(size_t)>* task;
+		WorkQueue* queue;
+		// Helpers still to join the job, and those working on it
+		size_t helpersWanted;
+		size_t helpersWorking;
+	};
+
+	void work();
+
+	std::mutex m_mutex;
+	std::condition_variable m_jobAdded;
+	std::condition_variable m_helperDone;
+	std::deque<Job*> m_jobs;
+	std::vector<std::thread> m_threads;
+	size_t m_idleThreads = 0;
+	bool m_stopping = false;
+};
+
+// Splits [0, count) into contiguous ranges and calls body(begin, end) for each of them in parallel
+template <typename Body>
+void parallelFor(size_t count, size_t threadCount, Body&& body)
+{
+	threadCount = std::max<size_t>(1, std::min(threadCount, count));
+	runOnThreads(threadCount, [&](size_t threadIndex)
+	{
+		auto begin = count * threadIndex / threadCount;
+		auto end = count * (threadIndex + 1) / threadCount;
+		body(begin, end);
+	});
+}
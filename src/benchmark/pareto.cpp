@@ -0,0 +1,272 @@
+#include "pareto.hpp"
+#include "svg_chart.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+
+namespace
+{
+const size_t NoEntry = std::numeric_limits<size_t>::max();
+
+bool qualityAvailable(const Benchmark::Results& results, ParetoMetric metric)
+{
+	return metric == ParetoMetric::RMSE || (results.quality.computed.psnr && results.quality.channelCount > 0);
+}
+
+double qualityOf(const Benchmark::Results& results, ParetoMetric metric)
+{
+	if (metric == ParetoMetric::RMSE)
+	{
+		return results.compressionError;
+	}
+
+	double sum = 0.0;
+	for (size_t i = 0; i < results.quality.channelCount; ++i)
+	{
+		sum += results.quality.psnr[i];
+	}
+	return sum / results.quality.channelCount;
+}
+
+// At least as good, RMSE is better when lower and PSNR when higher
+bool atLeastAsGood(double lhs, double rhs, ParetoMetric metric)
+{
+	return metric == ParetoMetric::RMSE ? lhs <= rhs : lhs >= rhs;
+}
+
+bool dominates(const ParetoEntry& lhs, const ParetoEntry& rhs, ParetoMetric metric)
+{
+	return lhs.throughput >= rhs.throughput &&
+		atLeastAsGood(lhs.quality, rhs.quality, metric) &&
+		(lhs.throughput > rhs.throughput || lhs.quality != rhs.quality);
+}
+
+const char* metricName(ParetoMetric metric)
+{
+	return metric == ParetoMetric::RMSE ? "rmse" : "psnr";
+}
+
+void writeCsv(std::ostream& out, const ParetoFront& front, const std::vector<ConfigurationResults>& allResults, ParetoMetric metric)
+{
+	out << std::setprecision(std::numeric_limits<double>::max_digits10);
+	out << "configuration,throughput_bytes_per_sec," << metricName(metric) << ",frontier,dominated_by" << std::endl;
+	for (const auto& entry : front.entries)
+	{
+		out << "\"" << describe(allResults[entry.resultIndex].config) << "\"," << entry.throughput << "," << entry.quality << ",";
+		out << entry.onFrontier << ",";
+		if (!entry.onFrontier)
+		{
+			out << "\"" << describe(allResults[entry.dominatedBy].config) << "\"";
+		}
+		out << std::endl;
+	}
+}
+
+// Throughput on a log scale since codecs differ by orders of magnitude, the metric on a linear one.
+// Frontier points are connected in throughput order, dominated points are drawn in gray.
+void writeSvg(std::ostream& out, const ParetoFront& front, const std::vector<ConfigurationResults>& allResults, ParetoMetric metric)
+{
+	const SvgChart chart = { 900.0, 600.0, 70.0, 260.0, 40.0, 60.0 };
+
+	auto minThroughput = std::numeric_limits<double>::max();
+	auto maxThroughput = 0.0;
+	auto minQuality = std::numeric_limits<double>::max();
+	auto maxQuality = std::numeric_limits<double>::lowest();
+	for (const auto& entry : front.entries)
+	{
+		minThroughput = std::min(minThroughput, entry.throughput);
+		maxThroughput = std::max(maxThroughput, entry.throughput);
+		if (std::isfinite(entry.quality))
+		{
+			minQuality = std::min(minQuality, entry.quality);
+			maxQuality = std::max(maxQuality, entry.quality);
+		}
+	}
+
+	// Whole decades on the throughput axis, some headroom on the metric axis
+	auto minDecade = std::floor(std::log10(std::max(minThroughput, 1.0)));
+	auto maxDecade = std::max(minDecade + 1.0, std::ceil(std::log10(std::max(maxThroughput, 1.0))));
+	if (minQuality > maxQuality)
+	{
+		minQuality = maxQuality = 0.0;
+	}
+	auto padding = std::max((maxQuality - minQuality) * 0.1, 1e-3);
+	minQuality = metric == ParetoMetric::RMSE ? std::max(0.0, minQuality - padding) : minQuality - padding;
+	maxQuality += padding;
+
+	auto x = [&](double throughput)
+	{
+		auto decade = std::log10(std::max(throughput, 1.0));
+		return chart.left + (decade - minDecade) / (maxDecade - minDecade) * chart.plotWidth();
+	};
+	auto y = [&](double quality)
+	{
+		quality = std::min(std::max(quality, minQuality), maxQuality);
+		return chart.top + (maxQuality - quality) / (maxQuality - minQuality) * chart.plotHeight();
+	};
+
+	writeSvgChartStart(out, chart, std::string(toString(front.format)) + " " + metricName(metric) + " vs throughput");
+
+	// A tick per decade of throughput and five ticks of the metric
+	for (auto decade = minDecade; decade <= maxDecade; decade += 1.0)
+	{
+		auto tickX = x(std::pow(10.0, decade));
+		out << "<line x1=\"" << tickX << "\" y1=\"" << chart.height - chart.bottom << "\" x2=\"" << tickX << "\" y2=\"" << chart.height - chart.bottom + 5 << "\" stroke=\"black\"/>" << std::endl;
+		out << "<text x=\"" << tickX << "\" y=\"" << chart.height - chart.bottom + 18 << "\" text-anchor=\"middle\">" << formatBytes(static_cast<size_t>(std::pow(10.0, decade))) << "/s</text>" << std::endl;
+	}
+	for (size_t i = 0; i <= 4; ++i)
+	{
+		auto value = minQuality + (maxQuality - minQuality) * i / 4.0;
+		out << "<text x=\"" << chart.left - 6 << "\" y=\"" << y(value) + 4 << "\" text-anchor=\"end\">" << std::setprecision(metric == ParetoMetric::RMSE ? 4 : 1) << value << "</text>" << std::endl;
+	}
+	out << std::setprecision(1);
+	out << "<text x=\"" << (chart.left + chart.width - chart.right) / 2 << "\" y=\"" << chart.height - 15 << "\" text-anchor=\"middle\">throughput (log scale)</text>" << std::endl;
+	out << "<text transform=\"translate(16," << (chart.top + chart.height - chart.bottom) / 2 << ") rotate(-90)\" text-anchor=\"middle\">" << metricName(metric) << "</text>" << std::endl;
+
+	std::string frontierPath;
+	for (const auto& entry : front.entries)
+	{
+		if (entry.onFrontier)
+		{
+			addSvgPathPoint(frontierPath, x(entry.throughput), y(entry.quality));
+		}
+	}
+	writeSvgPath(out, frontierPath, "#1f77b4");
+
+	for (const auto& entry : front.entries)
+	{
+		auto pointX = x(entry.throughput);
+		auto pointY = y(entry.quality);
+		auto color = entry.onFrontier ? "#1f77b4" : "#aaaaaa";
+		out << "<circle cx=\"" << pointX << "\" cy=\"" << pointY << "\" r=\"4\" fill=\"" << color << "\"/>" << std::endl;
+		out << "<text x=\"" << pointX + 7 << "\" y=\"" << pointY + 4 << "\" fill=\"" << (entry.onFrontier ? "black" : "#888888") << "\">";
+		out << describe(allResults[entry.resultIndex].config) << "</text>" << std::endl;
+	}
+
+	writeSvgChartEnd(out);
+}
+} // namespace
+
+bool parseParetoMetric(const std::string& str, ParetoMetric& metric)
+{
+	if (str == "rmse")
+	{
+		metric = ParetoMetric::RMSE;
+	}
+	else if (str == "psnr")
+	{
+		metric = ParetoMetric::PSNR;
+	}
+	else
+	{
+		std::cerr << "Unknown Pareto metric " << str << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::vector<ParetoFront> computeParetoFronts(const std::vector<ConfigurationResults>& allResults, ParetoMetric metric)
+{
+	std::vector<ParetoFront> fronts;
+	for (size_t i = 0, n = allResults.size(); i < n; ++i)
+	{
+		const auto& results = allResults[i].results;
+		if (results.hasErrors || !qualityAvailable(results, metric))
+		{
+			continue;
+		}
+
+		auto format = allResults[i].config.format;
+		auto front = std::find_if(std::begin(fronts), std::end(fronts), [&](const ParetoFront& f) { return f.format == format; });
+		if (front == std::end(fronts))
+		{
+			fronts.push_back({ format, {} });
+			front = std::prev(std::end(fronts));
+		}
+
+		front->entries.push_back({ i, static_cast<double>(results.throughputBytesPerSec), qualityOf(results, metric), true, NoEntry });
+	}
+
+	for (auto& front : fronts)
+	{
+		auto& entries = front.entries;
+		for (auto& entry : entries)
+		{
+			entry.onFrontier = std::none_of(std::begin(entries), std::end(entries), [&](const ParetoEntry& other) { return dominates(other, entry, metric); });
+		}
+
+		// Dominance is transitive, so some frontier entry always dominates a dominated one
+		for (auto& entry : entries)
+		{
+			if (entry.onFrontier)
+			{
+				continue;
+			}
+
+			for (const auto& other : entries)
+			{
+				if (other.onFrontier && dominates(other, entry, metric))
+				{
+					entry.dominatedBy = other.resultIndex;
+					break;
+				}
+			}
+		}
+
+		std::sort(std::begin(entries), std::end(entries), [](const ParetoEntry& lhs, const ParetoEntry& rhs) { return lhs.throughput > rhs.throughput; });
+	}
+
+	return fronts;
+}
+
+void printParetoFronts(std::ostream& out, const std::vector<ParetoFront>& fronts, const std::vector<ConfigurationResults>& allResults, ParetoMetric metric)
+{
+	for (const auto& front : fronts)
+	{
+		out << std::endl << "Pareto frontier of " << toString(front.format) << " (throughput vs " << metricName(metric) << ")" << std::endl;
+		for (const auto& entry : front.entries)
+		{
+			out << (entry.onFrontier ? "  * " : "    ") << describe(allResults[entry.resultIndex].config) << "\t\t";
+			out << formatBytes(static_cast<size_t>(entry.throughput)) << "/s\t\t";
+			out << metricName(metric) << " " << std::fixed << std::setprecision(metric == ParetoMetric::RMSE ? 5 : 2) << entry.quality;
+			if (!entry.onFrontier)
+			{
+				out << "\t\tdominated by " << describe(allResults[entry.dominatedBy].config);
+			}
+			out << std::endl;
+		}
+	}
+}
+
+bool writeParetoFronts(const std::string& dir, const std::vector<ParetoFront>& fronts, const std::vector<ConfigurationResults>& allResults, ParetoMetric metric)
+{
+	std::error_code error;
+	std::filesystem::create_directories(dir, error);
+
+	for (const auto& front : fronts)
+	{
+		auto base = (std::filesystem::path(dir) / (std::string("pareto_") + toString(front.format))).string();
+
+		std::ofstream csv(base + ".csv");
+		std::ofstream svg(base + ".svg");
+		if (!csv || !svg)
+		{
+			return false;
+		}
+
+		writeCsv(csv, front, allResults, metric);
+		writeSvg(svg, front, allResults, metric);
+		if (!csv || !svg)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "report.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class ParetoMetric
+{
+	RMSE,
+	PSNR,
+};
+
+bool parseParetoMetric(const std::string& str, ParetoMetric& metric);
+
+// Position of one configuration relative to the others of the same format.
+// Configurations with errors, or without the chosen metric, are left out.
+struct ParetoEntry
+{
+	size_t resultIndex;
+	double throughput;
+	// RMSE, or PSNR averaged over the relevant channels, in which case higher is better
+	double quality;
+	bool onFrontier;
+	// Index into allResults of a configuration that is at least as fast and as good, if dominated
+	size_t dominatedBy;
+};
+
+struct ParetoFront
+{
+	CompressedFormat format;
+	// Sorted by throughput, fastest first
+	std::vector<ParetoEntry> entries;
+};
+
+// One front per format present in the results, in order of first appearance
+std::vector<ParetoFront> computeParetoFronts(const std::vector<ConfigurationResults>& allResults, ParetoMetric metric);
+
+void printParetoFronts(std::ostream& out, const std::vector<ParetoFront>& fronts, const std::vector<ConfigurationResults>& allResults, ParetoMetric metric);
+
+// Writes pareto_<format>.csv and pareto_<format>.svg for every front into dir
+bool writeParetoFronts(const std::string& dir, const std::vector<ParetoFront>& fronts, const std::vector<ConfigurationResults>& allResults, ParetoMetric metric);
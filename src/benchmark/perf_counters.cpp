@@ -0,0 +1,213 @@
+#include "perf_counters.hpp"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+const char* toString(PerfEvent event)
+{
+	switch (event)
+	{
+	case PerfEvent::Cycles: return "cycles";
+	case PerfEvent::Instructions: return "instructions";
+	case PerfEvent::L1DataMisses: return "L1D misses";
+	case PerfEvent::LastLevelCacheMisses: return "LLC misses";
+	case PerfEvent::BranchMisses: return "branch misses";
+	case PerfEvent::StalledCyclesFrontend: return "frontend stalls";
+	case PerfEvent::StalledCyclesBackend: return "backend stalls";
+	default: return "unknown";
+	}
+}
+
+bool PerfCounterValues::isAvailable(PerfEvent event) const
+{
+	auto i = static_cast<size_t>(event);
+	return measurements > 0 && opened[i] && timeRunning[i] > 0;
+}
+
+double PerfCounterValues::value(PerfEvent event) const
+{
+	auto i = static_cast<size_t>(event);
+	if (timeRunning[i] == 0)
+	{
+		return 0.0;
+	}
+
+	return static_cast<double>(values[i]) * timeEnabled[i] / timeRunning[i];
+}
+
+void PerfCounterValues::add(const PerfCounterValues& other)
+{
+	if (other.measurements == 0)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < PerfEventCount; ++i)
+	{
+		opened[i] = (measurements == 0 || opened[i]) && other.opened[i];
+		values[i] += other.values[i];
+		timeEnabled[i] += other.timeEnabled[i];
+		timeRunning[i] += other.timeRunning[i];
+	}
+
+	measurements += other.measurements;
+}
+
+#if defined(__linux__)
+
+namespace
+{
+void describeEvent(PerfEvent event, perf_event_attr& attr)
+{
+	auto cacheMiss = [](uint64_t cache)
+	{
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	};
+
+	switch (event)
+	{
+	case PerfEvent::Cycles:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case PerfEvent::Instructions:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case PerfEvent::L1DataMisses:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = cacheMiss(PERF_COUNT_HW_CACHE_L1D);
+		break;
+	case PerfEvent::LastLevelCacheMisses:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = cacheMiss(PERF_COUNT_HW_CACHE_LL);
+		break;
+	case PerfEvent::BranchMisses:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	case PerfEvent::StalledCyclesFrontend:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_STALLED_CYCLES_FRONTEND;
+		break;
+	case PerfEvent::StalledCyclesBackend:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+		break;
+	default:
+		break;
+	}
+}
+
+struct ReadFormat
+{
+	uint64_t value;
+	uint64_t timeEnabled;
+	uint64_t timeRunning;
+};
+} // namespace
+
+PerfCounters::PerfCounters()
+{
+	for (size_t i = 0; i < PerfEventCount; ++i)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		describeEvent(static_cast<PerfEvent>(i), attr);
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		m_fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+	for (auto fd : m_fds)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+}
+
+void PerfCounters::start()
+{
+	for (auto fd : m_fds)
+	{
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+void PerfCounters::stop(PerfCounterValues& values)
+{
+	for (auto fd : m_fds)
+	{
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+
+	PerfCounterValues measurement;
+	measurement.measurements = 1;
+	for (size_t i = 0; i < PerfEventCount; ++i)
+	{
+		ReadFormat data;
+		if (m_fds[i] < 0 || read(m_fds[i], &data, sizeof(data)) != sizeof(data))
+		{
+			continue;
+		}
+
+		// The counters keep running totals, a measurement is the difference to the previous read
+		measurement.opened[i] = true;
+		measurement.values[i] = data.value - m_lastValues[i];
+		measurement.timeEnabled[i] = data.timeEnabled - m_lastEnabled[i];
+		measurement.timeRunning[i] = data.timeRunning - m_lastRunning[i];
+		m_lastValues[i] = data.value;
+		m_lastEnabled[i] = data.timeEnabled;
+		m_lastRunning[i] = data.timeRunning;
+	}
+
+	values.add(measurement);
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+	for (auto& fd : m_fds)
+	{
+		fd = -1;
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::start()
+{
+}
+
+void PerfCounters::stop(PerfCounterValues& values)
+{
+	PerfCounterValues measurement;
+	measurement.measurements = 1;
+	values.add(measurement);
+}
+
+#endif
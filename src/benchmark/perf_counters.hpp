@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class PerfEvent
+{
+	Cycles,
+	Instructions,
+	L1DataMisses,
+	LastLevelCacheMisses,
+	BranchMisses,
+	StalledCyclesFrontend,
+	StalledCyclesBackend,
+	Count,
+};
+
+const size_t PerfEventCount = static_cast<size_t>(PerfEvent::Count);
+
+const char* toString(PerfEvent event);
+
+// Event totals summed over a number of measurements. An event counts as available
+// only when every measurement that went into the sum had it open. Multiplexing is
+// corrected for on the totals, short measurements may not get a counter at all.
+struct PerfCounterValues
+{
+	size_t measurements = 0;
+	bool opened[PerfEventCount] = {};
+	uint64_t values[PerfEventCount] = {};
+	uint64_t timeEnabled[PerfEventCount] = {};
+	uint64_t timeRunning[PerfEventCount] = {};
+
+	bool isAvailable(PerfEvent event) const;
+	// Estimated count, the raw count scaled by the fraction of time the event was actually counted
+	double value(PerfEvent event) const;
+
+	void add(const PerfCounterValues& other);
+};
+
+// Hardware counters of the calling thread, user mode only, opened through perf_event_open.
+// Threads of a codec are not counted, events aren't inherited as a codec
+// keeps its pool from before the counters were opened. Events the kernel refuses
+// (no PMU in a VM, perf_event_paranoid, unsupported event) are simply left unavailable,
+// on platforms other than Linux nothing is ever available.
+class PerfCounters final
+{
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	void start();
+	// Adds the events counted since start() to values
+	void stop(PerfCounterValues& values);
+
+private:
+	int m_fds[PerfEventCount];
+	uint64_t m_lastValues[PerfEventCount] = {};
+	uint64_t m_lastEnabled[PerfEventCount] = {};
+	uint64_t m_lastRunning[PerfEventCount] = {};
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Blocking FIFO with a fixed capacity, used to connect pipeline stages
+template <typename T>
+class BoundedQueue final
+{
+public:
+	BoundedQueue(size_t capacity) : m_capacity(std::max<size_t>(capacity, 1)) {}
+
+	// Blocks while the queue is full
+	void push(T item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notFull.wait(lock, [this]() { return m_items.size() < m_capacity; });
+		m_items.push_back(std::move(item));
+		m_notEmpty.notify_one();
+	}
+
+	// Blocks until an item is available, returns false once the queue is closed and drained
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_notEmpty.wait(lock, [this]() { return !m_items.empty() || m_closed; });
+		if (m_items.empty())
+		{
+			return false;
+		}
+
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		m_notFull.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+		m_notEmpty.notify_all();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_notEmpty;
+	std::condition_variable m_notFull;
+	std::deque<T> m_items;
+	const size_t m_capacity;
+	bool m_closed = false;
+};
+
+// Caps the amount of memory held by the items travelling through a pipeline.
+// A single request larger than the budget is still admitted when nothing else is in flight.
+class MemoryBudget final
+{
+public:
+	MemoryBudget(size_t budgetBytes) : m_budgetBytes(budgetBytes) {}
+
+	void acquire(size_t bytes)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_released.wait(lock, [this, bytes]() { return m_usedBytes == 0 || m_usedBytes + bytes <= m_budgetBytes; });
+		m_usedBytes += bytes;
+		m_peakBytes = std::max(m_peakBytes, m_usedBytes);
+	}
+
+	void release(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_usedBytes -= bytes;
+		m_released.notify_all();
+	}
+
+	size_t peakBytes() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_peakBytes;
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::condition_variable m_released;
+	const size_t m_budgetBytes;
+	size_t m_usedBytes = 0;
+	size_t m_peakBytes = 0;
+};
@@ -0,0 +1,354 @@
+#include "placement.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#endif
+
+namespace
+{
+#if defined(_WIN32)
+bool pinCurrentThread(size_t cpu, std::vector<unsigned char>& previous)
+{
+	// Only the first processor group is reachable through a thread affinity mask
+	if (cpu >= sizeof(DWORD_PTR) * 8)
+	{
+		std::cerr << "CPU " << cpu << " is outside of the first processor group, not pinning" << std::endl;
+		return false;
+	}
+
+	auto mask = SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+	if (mask == 0)
+	{
+		std::cerr << "Failed to pin a thread to CPU " << cpu << std::endl;
+		return false;
+	}
+
+	previous.resize(sizeof(mask));
+	std::memcpy(previous.data(), &mask, sizeof(mask));
+	return true;
+}
+
+void restoreCurrentThread(const std::vector<unsigned char>& previous)
+{
+	DWORD_PTR mask;
+	std::memcpy(&mask, previous.data(), sizeof(mask));
+	SetThreadAffinityMask(GetCurrentThread(), mask);
+}
+
+size_t cpuNode(size_t cpu)
+{
+	PROCESSOR_NUMBER processor = {};
+	processor.Number = static_cast<BYTE>(cpu);
+	USHORT node = 0;
+	return GetNumaProcessorNodeEx(&processor, &node) ? node : 0;
+}
+
+// Windows can't move the pages of an allocation, a fresh copy is placed by first touch instead
+bool bindToNode(std::vector<unsigned char>&, size_t)
+{
+	return false;
+}
+#elif defined(__linux__)
+bool pinCurrentThread(size_t cpu, std::vector<unsigned char>& previous)
+{
+	if (cpu >= CPU_SETSIZE)
+	{
+		std::cerr << "CPU " << cpu << " is out of range, not pinning" << std::endl;
+		return false;
+	}
+
+	cpu_set_t mask;
+	if (sched_getaffinity(0, sizeof(mask), &mask) != 0)
+	{
+		return false;
+	}
+
+	cpu_set_t pinned;
+	CPU_ZERO(&pinned);
+	CPU_SET(cpu, &pinned);
+	if (sched_setaffinity(0, sizeof(pinned), &pinned) != 0)
+	{
+		std::cerr << "Failed to pin a thread to CPU " << cpu << std::endl;
+		return false;
+	}
+
+	previous.resize(sizeof(mask));
+	std::memcpy(previous.data(), &mask, sizeof(mask));
+	return true;
+}
+
+void restoreCurrentThread(const std::vector<unsigned char>& previous)
+{
+	cpu_set_t mask;
+	std::memcpy(&mask, previous.data(), sizeof(mask));
+	sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+size_t readSysfsNumber(const std::string& path, size_t fallback)
+{
+	std::ifstream in(path);
+	size_t value;
+	return in >> value ? value : fallback;
+}
+
+// The CPU directory links to its node as nodeN
+size_t cpuNode(size_t cpu)
+{
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/cpu" + std::to_string(cpu), error))
+	{
+		auto name = entry.path().filename().string();
+		if (name.size() > 4 && name.compare(0, 4, "node") == 0 && std::isdigit(static_cast<unsigned char>(name[4])))
+		{
+			return std::stoul(name.substr(4));
+		}
+	}
+
+	return 0;
+}
+
+// Moves the whole pages of the buffer, the partial ones at both ends stay where they are
+bool bindToNode(std::vector<unsigned char>& bytes, size_t node)
+{
+	const unsigned long bindPolicy = 2;
+	const unsigned long movePages = 1 << 1;
+
+	auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+	auto begin = (reinterpret_cast<uintptr_t>(bytes.data()) + pageSize - 1) / pageSize * pageSize;
+	auto end = (reinterpret_cast<uintptr_t>(bytes.data()) + bytes.size()) / pageSize * pageSize;
+	if (end <= begin)
+	{
+		return true;
+	}
+
+	unsigned long nodeMask = 0;
+	if (node >= sizeof(nodeMask) * 8)
+	{
+		return false;
+	}
+	nodeMask = 1ul << node;
+
+	return syscall(SYS_mbind, begin, end - begin, bindPolicy, &nodeMask, sizeof(nodeMask) * 8, movePages) == 0;
+}
+#else
+bool pinCurrentThread(size_t, std::vector<unsigned char>&)
+{
+	return false;
+}
+
+void restoreCurrentThread(const std::vector<unsigned char>&)
+{
+}
+
+size_t cpuNode(size_t)
+{
+	return 0;
+}
+
+bool bindToNode(std::vector<unsigned char>&, size_t)
+{
+	return false;
+}
+#endif
+
+size_t workerCpu(const ThreadPlacement& placement, size_t threadIndex)
+{
+	return placement.cpus[threadIndex % placement.cpus.size()];
+}
+} // namespace
+
+bool parseNumaPlacement(const std::string& str, NumaPlacement& numa)
+{
+	if (str == "none")
+	{
+		numa = NumaPlacement::None;
+	}
+	else if (str == "firsttouch")
+	{
+		numa = NumaPlacement::FirstTouch;
+	}
+	else if (str == "bind")
+	{
+		numa = NumaPlacement::Bind;
+	}
+	else
+	{
+		std::cerr << "Unknown NUMA placement " << str << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+const char* toString(NumaPlacement numa)
+{
+	switch (numa)
+	{
+	case NumaPlacement::None: return "none";
+	case NumaPlacement::FirstTouch: return "firsttouch";
+	case NumaPlacement::Bind: return "bind";
+	default: return "unknown";
+	}
+}
+
+bool parseCpuList(const std::string& str, std::vector<size_t>& cpus)
+{
+	std::istringstream in(str);
+	std::string range;
+	while (std::getline(in, range, ','))
+	{
+		size_t first;
+		size_t last;
+		char dash;
+		std::istringstream rangeIn(range);
+		if (!(rangeIn >> first))
+		{
+			return false;
+		}
+
+		last = first;
+		if (rangeIn >> dash && (dash != '-' || !(rangeIn >> last) || last < first))
+		{
+			return false;
+		}
+
+		for (auto cpu = first; cpu <= last; ++cpu)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+
+	return !cpus.empty();
+}
+
+std::vector<size_t> physicalCoreCpus()
+{
+	std::vector<size_t> cpus;
+
+#if defined(_WIN32)
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+	std::vector<unsigned char> buffer(length);
+	auto info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+	if (!GetLogicalProcessorInformationEx(RelationProcessorCore, info, &length))
+	{
+		return cpus;
+	}
+
+	for (DWORD offset = 0; offset < length; )
+	{
+		auto core = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+		const auto& group = core->Processor.GroupMask[0];
+		if (group.Group == 0 && group.Mask != 0)
+		{
+			unsigned long lowest;
+			_BitScanForward64(&lowest, group.Mask);
+			cpus.push_back(lowest);
+		}
+		offset += core->Size;
+	}
+#elif defined(__linux__)
+	// (package, core) of the first CPU found on each core
+	std::vector<std::tuple<size_t, size_t, size_t>> cores;
+	for (long cpu = 0, n = sysconf(_SC_NPROCESSORS_CONF); cpu < n; ++cpu)
+	{
+		auto topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+		auto package = readSysfsNumber(topology + "physical_package_id", SIZE_MAX);
+		auto core = readSysfsNumber(topology + "core_id", SIZE_MAX);
+		if (package == SIZE_MAX || core == SIZE_MAX)
+		{
+			continue;
+		}
+
+		auto known = std::any_of(std::begin(cores), std::end(cores), [&](const std::tuple<size_t, size_t, size_t>& entry)
+		{
+			return std::get<0>(entry) == package && std::get<1>(entry) == core;
+		});
+		if (!known)
+		{
+			cores.emplace_back(package, core, static_cast<size_t>(cpu));
+		}
+	}
+
+	std::sort(std::begin(cores), std::end(cores));
+	for (const auto& entry : cores)
+	{
+		cpus.push_back(std::get<2>(entry));
+	}
+#endif
+
+	return cpus;
+}
+
+ThreadPinning::ThreadPinning(const ThreadPlacement& placement, size_t threadIndex)
+{
+	if (!placement.cpus.empty())
+	{
+		m_pinned = pinCurrentThread(workerCpu(placement, threadIndex), m_previous);
+	}
+}
+
+ThreadPinning::~ThreadPinning()
+{
+	if (m_pinned)
+	{
+		restoreCurrentThread(m_previous);
+	}
+}
+
+bool placeDataSet(DataSet& dataSet, const ThreadPlacement& placement, size_t threadCount)
+{
+	if (placement.numa == NumaPlacement::None)
+	{
+		return true;
+	}
+
+	if (placement.cpus.empty())
+	{
+		std::cerr << "NUMA placement needs pinned worker threads" << std::endl;
+		return false;
+	}
+
+	threadCount = std::max<size_t>(threadCount, 1);
+	auto bindFailed = false;
+	for (size_t i = 0; i < dataSet.size(); ++i)
+	{
+		auto& bytes = dataSet[i].image.bytes;
+		auto worker = i % threadCount;
+		if (placement.numa == NumaPlacement::Bind && bindToNode(bytes, cpuNode(workerCpu(placement, worker))))
+		{
+			continue;
+		}
+		bindFailed = bindFailed || placement.numa == NumaPlacement::Bind;
+
+		// Large buffers come straight from the OS, so the copying thread is the first to touch their pages
+		std::thread([&]()
+		{
+			ThreadPinning pinning(placement, worker);
+			std::vector<unsigned char> placed(std::begin(bytes), std::end(bytes));
+			bytes.swap(placed);
+		}).join();
+	}
+
+	if (bindFailed)
+	{
+		std::cerr << "Failed to bind some images to their NUMA nodes, they were placed by first touch" << std::endl;
+	}
+
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "dataset.hpp"
+
+#include <string>
+#include <vector>
+
+enum class NumaPlacement
+{
+	None,
+	// Every image is copied by a thread pinned to the CPU of the worker that compresses it
+	FirstTouch,
+	// The pages of every image are moved to the node of that worker, first touch where that isn't supported
+	Bind,
+};
+
+struct ThreadPlacement
+{
+	// Worker i runs on cpus[i % cpus.size()], empty leaves scheduling to the OS
+	std::vector<size_t> cpus;
+	NumaPlacement numa = NumaPlacement::None;
+};
+
+bool parseNumaPlacement(const std::string& str, NumaPlacement& numa);
+const char* toString(NumaPlacement numa);
+
+// Comma separated CPU numbers and ranges, e.g. 0-3,8,10
+bool parseCpuList(const std::string& str, std::vector<size_t>& cpus);
+
+// One logical CPU of every physical core, ordered by package and core
+std::vector<size_t> physicalCoreCpus();
+
+// Pins the calling thread to the CPU of worker threadIndex for its lifetime and restores the previous affinity after.
+// Threads it starts meanwhile inherit the single CPU, which is why pinned runs keep codecs to one thread.
+class ThreadPinning final
+{
+public:
+	ThreadPinning(const ThreadPlacement& placement, size_t threadIndex);
+	~ThreadPinning();
+
+	ThreadPinning(const ThreadPinning&) = delete;
+	ThreadPinning& operator=(const ThreadPinning&) = delete;
+
+private:
+	bool m_pinned = false;
+	// Affinity mask of the platform as raw bytes
+	std::vector<unsigned char> m_previous;
+};
+
+// Puts image i on the NUMA node of worker i % threadCount, which is the worker that compresses it
+// when the placement is set and the run uses threadCount workers throughout. Nothing to do without placement.numa.
+bool placeDataSet(DataSet& dataSet, const ThreadPlacement& placement, size_t threadCount);
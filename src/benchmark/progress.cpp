@@ -0,0 +1,86 @@
+#include "progress.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+// h:mm:ss, or m:ss below an hour
+std::string formatDuration(double seconds)
+{
+	auto total = static_cast<uint64_t>(std::max(0.0, seconds) + 0.5);
+	std::ostringstream out;
+	if (total >= 3600)
+	{
+		out << total / 3600 << ":" << std::setw(2) << std::setfill('0') << total / 60 % 60;
+	}
+	else
+	{
+		out << total / 60;
+	}
+	out << ":" << std::setw(2) << std::setfill('0') << total % 60;
+	return out.str();
+}
+} // namespace
+
+ProgressReporter::ProgressReporter(size_t totalItems, double budgetSeconds)
+	: m_total(totalItems)
+	, m_budgetSeconds(budgetSeconds)
+	, m_start(Clock::now())
+{
+	m_thread = std::thread([this]()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_wake.wait_for(lock, std::chrono::seconds(1), [this]() { return m_stopping; }))
+		{
+			print();
+		}
+	});
+}
+
+ProgressReporter::~ProgressReporter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+
+	// Runs shorter than an update leave no line behind
+	if (elapsedNanoseconds(m_start, Clock::now()) >= 1000000000)
+	{
+		print();
+		std::cerr << std::endl;
+	}
+}
+
+void ProgressReporter::print()
+{
+	auto done = std::min(m_done.load(std::memory_order_relaxed), m_total);
+	auto elapsed = elapsedNanoseconds(m_start, Clock::now()) * 1e-9;
+
+	std::ostringstream line;
+	line << "\rProgress " << std::fixed << std::setprecision(1) << (m_total > 0 ? 100.0 * done / m_total : 100.0) << "%";
+	line << " (" << done << "/" << m_total << ")\t\tElapsed " << formatDuration(elapsed) << "\t\tETA ";
+
+	if (done == 0 && m_budgetSeconds <= 0.0)
+	{
+		line << "unknown";
+	}
+	else
+	{
+		auto left = done > 0 ? elapsed * (m_total - done) / done : m_budgetSeconds;
+		if (m_budgetSeconds > 0.0)
+		{
+			left = std::min(left, std::max(0.0, m_budgetSeconds - elapsed));
+		}
+		line << formatDuration(left);
+	}
+
+	// Padding clears what is left of a longer previous line
+	std::cerr << line.str() << "    " << std::flush;
+}
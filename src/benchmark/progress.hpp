@@ -0,0 +1,36 @@
+#pragma once
+
+#include "timing.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Overwrites one line on stderr about once a second with the share of items done, the elapsed time and
+// the estimated time left, which is capped by the time budget when there is one. Ends the line when destroyed.
+class ProgressReporter final
+{
+public:
+	ProgressReporter(size_t totalItems, double budgetSeconds);
+	~ProgressReporter();
+
+	ProgressReporter(const ProgressReporter&) = delete;
+	ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+	// Called by any thread once an item is done
+	void advance() { m_done.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+	void print();
+
+	const size_t m_total;
+	const double m_budgetSeconds;
+	const Clock::time_point m_start;
+	std::atomic<size_t> m_done = 0;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping = false;
+	std::thread m_thread;
+};
@@ -0,0 +1,420 @@
+#include "report.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+std::string formatBytes(size_t bytes)
+{
+	static const char* prefixes[] = { "B", "KB", "MB", "GB", "TB" };
+	static const size_t prefixCount = sizeof(prefixes) / sizeof(prefixes[0]);
+
+	size_t n = 0;
+	auto fbytes = static_cast<float>(bytes);
+	while (n < prefixCount - 1 && fbytes >= 1024.f)
+	{
+		++n;
+		fbytes /= 1024.f;
+	}
+
+	std::stringstream buffer;
+	if (n == 0 || fbytes >= 100.f || fbytes - static_cast<size_t>(fbytes) < 0.05f)
+	{
+		buffer << static_cast<size_t>(fbytes) << " " << prefixes[n];
+	}
+	else
+	{
+		fbytes = std::round(fbytes * 10.f) / 10.f;
+		buffer << std::fixed << std::setprecision(1) << fbytes << " " << prefixes[n];
+	}
+
+	return buffer.str();
+}
+
+std::string formatStatistics(const Statistics& statistics, double scale)
+{
+	std::stringstream buffer;
+	buffer << std::fixed << std::setprecision(3);
+	buffer << "min " << statistics.min * scale;
+	buffer << " median " << statistics.median * scale;
+	buffer << " mean " << statistics.mean * scale;
+	buffer << " p90 " << statistics.p90 * scale;
+	buffer << " p99 " << statistics.p99 * scale;
+	return buffer.str();
+}
+
+namespace
+{
+void printChannelValues(std::ostream& out, const char* name, const double values[4], size_t channelCount, int precision)
+{
+	static const char channelNames[] = { 'R', 'G', 'B', 'A' };
+
+	out << name;
+	for (size_t channel = 0; channel < channelCount; ++channel)
+	{
+		out << " " << channelNames[channel] << " " << std::fixed << std::setprecision(precision) << values[channel];
+	}
+}
+
+void printQualityMetrics(std::ostream& out, const QualityMetrics& quality)
+{
+	if (!quality.computed.any())
+	{
+		return;
+	}
+
+	const char* separator = "";
+	if (quality.computed.psnr)
+	{
+		printChannelValues(out, "PSNR (dB)", quality.psnr, quality.channelCount, 2);
+		separator = "\t\t";
+	}
+	if (quality.computed.ssim)
+	{
+		out << separator;
+		printChannelValues(out, "SSIM", quality.ssim, quality.channelCount, 5);
+		separator = "\t\t";
+	}
+	if (quality.computed.msssim)
+	{
+		out << separator;
+		printChannelValues(out, "MS-SSIM", quality.msssim, quality.channelCount, 5);
+	}
+	out << std::endl;
+}
+
+void printHexRow(std::ostream& out, const unsigned char* pixels)
+{
+	out << std::hex << std::setfill('0');
+	for (size_t i = 0; i < 16; ++i)
+	{
+		out << std::setw(2) << static_cast<unsigned>(pixels[i]) << ((i % 4 == 3) ? " " : "");
+	}
+	out << std::dec << std::setfill(' ');
+}
+
+// Energy per MB of input and average power over the timed passes, nothing without readable RAPL counters
+void printEnergy(std::ostream& out, const Benchmark::Results& results)
+{
+	const auto& energy = results.energy;
+	if (!energy.available)
+	{
+		return;
+	}
+
+	out << "Energy " << std::fixed << std::setprecision(3) << energy.joulesPerMegabyte(results.processedBytes) << " J/MB\t\t";
+	out << "Average power " << std::setprecision(1) << energy.averageWatts() << " W\t\t";
+	out << "Package " << std::setprecision(2) << energy.packageJoules << " J";
+	if (energy.hasDram)
+	{
+		out << "\t\tDRAM " << energy.dramJoules << " J";
+	}
+	out << std::endl;
+}
+
+void printExtrapolation(std::ostream& out, const Benchmark::Results& results)
+{
+	const auto& extrapolation = results.extrapolation;
+	if (!extrapolation.applied)
+	{
+		return;
+	}
+
+	out << "Time budget reached, " << extrapolation.timedImages << " of " << extrapolation.totalImages << " images timed";
+	if (extrapolation.timedImages < extrapolation.totalImages)
+	{
+		out << ", the others extrapolated at " << std::fixed << std::setprecision(3) << extrapolation.nanosecondsPerPixel << " ns/pixel";
+		out << " + " << extrapolation.nanosecondsPerImage * 1e-6 << " ms/image, error of the timed images only";
+	}
+	out << std::endl;
+}
+
+// IPC and events per block for whatever the kernel let us count, nothing when counters weren't requested
+void printPerfCounters(std::ostream& out, const Benchmark::Results& results)
+{
+	const auto& counters = results.perfCounters;
+	if (counters.measurements == 0)
+	{
+		return;
+	}
+
+	if (counters.isAvailable(PerfEvent::Cycles) && counters.isAvailable(PerfEvent::Instructions))
+	{
+		auto cycles = counters.value(PerfEvent::Cycles);
+		out << "IPC " << std::fixed << std::setprecision(2) << (cycles > 0.0 ? counters.value(PerfEvent::Instructions) / cycles : 0.0);
+	}
+	else
+	{
+		out << "IPC n/a";
+	}
+
+	auto blocks = static_cast<double>(std::max<uint64_t>(results.perfCounterBlocks, 1));
+	size_t availableCount = 0;
+	for (size_t i = 0; i < PerfEventCount; ++i)
+	{
+		auto event = static_cast<PerfEvent>(i);
+		if (counters.isAvailable(event))
+		{
+			out << "\t\t" << toString(event) << "/block " << std::fixed << std::setprecision(2) << counters.value(event) / blocks;
+			++availableCount;
+		}
+	}
+
+	if (availableCount == 0)
+	{
+		out << "\t\tHardware counters not available";
+	}
+	else if (results.codecThreadCount != 1)
+	{
+		out << "\t\tCalling threads only";
+	}
+	out << std::endl;
+}
+
+void printMemoryUsage(std::ostream& out, const MemoryUsage& memory, const char* allocationsLabel)
+{
+	out << "Peak RSS " << formatBytes(memory.peakResidentSetBytes) << " (+" << formatBytes(memory.residentSetGrowthBytes) << ")\t\t";
+	out << allocationsLabel << " " << memory.allocationCount << " (" << formatBytes(memory.allocatedBytes) << ")";
+}
+
+// Prints whatever the block error pass collected, an empty histogram means it wasn't requested
+void printBlockErrors(std::ostream& out, const Benchmark::ImageResults& image)
+{
+	const auto& report = image.blockErrors;
+	if (std::any_of(std::begin(report.histogram), std::end(report.histogram), [](size_t count) { return count > 0; }))
+	{
+		out << image.name << " block RMSE histogram:";
+		for (size_t i = 0; i < BlockErrorHistogramSize; ++i)
+		{
+			out << "  " << (i == 0 ? std::string("<1") : "<" + std::to_string(size_t(1) << i)) << " " << report.histogram[i];
+		}
+		out << std::endl;
+	}
+
+	for (const auto& block : report.worstBlocks)
+	{
+		out << image.name << " block (" << block.x << ", " << block.y << ")\t\t";
+		out << "RMSE " << std::fixed << std::setprecision(2) << block.error << std::endl;
+		for (size_t row = 0; row < 4; ++row)
+		{
+			out << "\t";
+			printHexRow(out, block.source + row * 16);
+			out << "  ->  ";
+			printHexRow(out, block.decoded + row * 16);
+			out << std::endl;
+		}
+	}
+}
+} // namespace
+
+void printResults(std::ostream& out, const Benchmark::Results& results, bool perImage)
+{
+	if (results.hasErrors)
+	{
+		out << "Benchmark completed with errors!" << std::endl;
+	}
+
+	out << "Compressed in " << std::fixed << std::setprecision(4) << results.elapsedSeconds << " sec\t\t";
+	out << "Throughput " << formatBytes(results.throughputBytesPerSec) << "/sec\t\t";
+	out << "Error " << std::fixed << std::setprecision(5) << results.compressionError << std::endl;
+	out << "Threads " << results.threadCount;
+	if (results.codecThreadCount > 0)
+	{
+		out << " x " << results.codecThreadCount << " in codec";
+	}
+	out << "\t\t";
+	out << "Pass time (ms): " << formatStatistics(results.passNanoseconds, 1e-6) << "\t\t";
+	out << "Peak resident images " << formatBytes(results.peakResidentBytes) << "\t\t";
+	out << "Block time " << std::fixed << std::setprecision(1) << results.nanosecondsPerBlock << " ns" << std::endl;
+	printQualityMetrics(out, results.quality);
+	printPerfCounters(out, results);
+	if (results.memory.measurements > 0)
+	{
+		printMemoryUsage(out, results.memory, "Allocations per pass");
+		out << std::endl;
+	}
+	printEnergy(out, results);
+	printExtrapolation(out, results);
+	if (results.wallNanoseconds.median > 0.0)
+	{
+		out << "Wall time with loading (ms): " << formatStatistics(results.wallNanoseconds, 1e-6) << std::endl;
+	}
+
+	if (perImage)
+	{
+		for (const auto& image : results.images)
+		{
+			out << image.name << " (" << image.width << "x" << image.height << ")\t\t";
+			out << "Time (ms): " << formatStatistics(image.elapsedNanoseconds, 1e-6) << "\t\t";
+			out << "Cycles per block " << std::fixed << std::setprecision(1) << image.cyclesPerBlock;
+			if (image.memory.measurements > 0)
+			{
+				out << "\t\t";
+				printMemoryUsage(out, image.memory, "Allocations");
+			}
+			out << std::endl;
+		}
+	}
+
+	for (const auto& image : results.images)
+	{
+		printBlockErrors(out, image);
+	}
+}
+
+void printDecompressionResults(std::ostream& out, const std::vector<Benchmark::Results>& variants, bool perImage)
+{
+	for (const auto& results : variants)
+	{
+		if (results.hasErrors)
+		{
+			out << "Benchmark completed with errors!" << std::endl;
+		}
+
+		out << "Threads " << results.threadCount << "\t\t";
+		out << "Decompressed in " << std::fixed << std::setprecision(4) << results.elapsedSeconds << " sec\t\t";
+		out << "Throughput " << formatBytes(results.throughputBytesPerSec) << "/sec\t\t";
+		out << "Block time " << std::setprecision(1) << results.nanosecondsPerBlock << " ns" << std::endl;
+		out << "Pass time (ms): " << formatStatistics(results.passNanoseconds, 1e-6) << std::endl;
+		printPerfCounters(out, results);
+		if (results.memory.measurements > 0)
+		{
+			printMemoryUsage(out, results.memory, "Allocations per pass");
+			out << std::endl;
+		}
+		printEnergy(out, results);
+
+		if (perImage)
+		{
+			for (const auto& image : results.images)
+			{
+				out << image.name << " (" << image.width << "x" << image.height << ")\t\t";
+				out << "Time (ms): " << formatStatistics(image.elapsedNanoseconds, 1e-6) << "\t\t";
+				out << "Cycles per block " << std::fixed << std::setprecision(1) << image.cyclesPerBlock << std::endl;
+			}
+		}
+	}
+}
+
+void printScalingSweep(std::ostream& out, const std::vector<Benchmark::Results>& sweep)
+{
+	if (sweep.empty())
+	{
+		return;
+	}
+
+	auto baseline = sweep.front().elapsedSeconds;
+	for (const auto& results : sweep)
+	{
+		auto speedup = results.elapsedSeconds > 0.0 ? baseline / results.elapsedSeconds : 0.0;
+		auto efficiency = speedup / results.threadCount;
+
+		if (results.hasErrors)
+		{
+			out << "Benchmark completed with errors!" << std::endl;
+		}
+
+		out << "Threads " << results.threadCount << "\t\t";
+		out << "Compressed in " << std::fixed << std::setprecision(4) << results.elapsedSeconds << " sec\t\t";
+		out << "Throughput " << formatBytes(results.throughputBytesPerSec) << "/sec\t\t";
+		out << "Speedup " << std::setprecision(2) << speedup << "x\t\t";
+		out << "Efficiency " << std::setprecision(1) << efficiency * 100.0 << "%" << std::endl;
+	}
+}
+
+void printCacheStates(std::ostream& out, const std::vector<Benchmark::Results>& states, bool perImage)
+{
+	static const CacheState order[] = { CacheState::Cold, CacheState::Warm };
+	for (size_t i = 0; i < states.size() && i < 2; ++i)
+	{
+		out << "Caches " << toString(order[i]) << std::endl;
+		printResults(out, states[i], perImage);
+	}
+
+	if (states.size() == 2 && states[1].elapsedSeconds > 0.0)
+	{
+		out << "Cold caches take " << std::fixed << std::setprecision(2) << states[0].elapsedSeconds / states[1].elapsedSeconds;
+		out << "x the time of warm caches" << std::endl;
+	}
+}
+
+size_t bestThreadSplit(const std::vector<Benchmark::Results>& splits)
+{
+	size_t best = 0;
+	for (size_t i = 1; i < splits.size(); ++i)
+	{
+		auto better = splits[i].throughputBytesPerSec > splits[best].throughputBytesPerSec;
+		if ((splits[best].hasErrors && !splits[i].hasErrors) || (better && splits[i].hasErrors == splits[best].hasErrors))
+		{
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+void printThreadSplits(std::ostream& out, const std::vector<Benchmark::ThreadSplitGroup>& groups)
+{
+	for (const auto& group : groups)
+	{
+		if (group.splits.empty())
+		{
+			continue;
+		}
+
+		out << group.name << std::endl;
+		auto best = bestThreadSplit(group.splits);
+		for (size_t i = 0; i < group.splits.size(); ++i)
+		{
+			const auto& results = group.splits[i];
+			if (results.hasErrors)
+			{
+				out << "Benchmark completed with errors!" << std::endl;
+			}
+
+			out << "Images " << results.threadCount << " x codec threads " << results.codecThreadCount << "\t\t";
+			out << "Compressed in " << std::fixed << std::setprecision(4) << results.elapsedSeconds << " sec\t\t";
+			out << "Throughput " << formatBytes(results.throughputBytesPerSec) << "/sec" << (i == best ? "\t\tbest" : "") << std::endl;
+		}
+	}
+
+	out << "Best splits:" << std::endl;
+	for (const auto& group : groups)
+	{
+		if (!group.splits.empty())
+		{
+			const auto& best = group.splits[bestThreadSplit(group.splits)];
+			out << group.name << "\t\t" << best.threadCount << " x " << best.codecThreadCount << std::endl;
+		}
+	}
+}
+
+void printSummary(std::ostream& out, const std::vector<ConfigurationResults>& allResults)
+{
+	size_t width = 0;
+	for (const auto& entry : allResults)
+	{
+		width = std::max(width, describe(entry.config).size());
+	}
+
+	out << std::left << std::setw(width + 2) << "Configuration";
+	out << std::right << std::setw(12) << "Time (s)";
+	out << std::setw(16) << "Throughput/s";
+	out << std::setw(12) << "Error" << std::endl;
+
+	for (const auto& entry : allResults)
+	{
+		const auto& results = entry.results;
+		out << std::left << std::setw(width + 2) << describe(entry.config);
+		out << std::right << std::fixed << std::setprecision(4) << std::setw(12) << results.elapsedSeconds;
+		out << std::setw(16) << formatBytes(results.throughputBytesPerSec);
+		out << std::setprecision(5) << std::setw(12) << results.compressionError;
+		if (results.hasErrors)
+		{
+			out << "  (errors)";
+		}
+		out << std::endl;
+	}
+}
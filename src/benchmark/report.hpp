@@ -0,0 +1,31 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "configuration.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct ConfigurationResults
+{
+	Configuration config;
+	Benchmark::Results results;
+};
+
+std::string formatBytes(size_t bytes);
+std::string formatStatistics(const Statistics& statistics, double scale);
+
+void printResults(std::ostream& out, const Benchmark::Results& results, bool perImage);
+// Throughput of decompression is measured in bytes of RGBA output
+void printDecompressionResults(std::ostream& out, const std::vector<Benchmark::Results>& variants, bool perImage);
+void printScalingSweep(std::ostream& out, const std::vector<Benchmark::Results>& sweep);
+// Cold and then warm results as returned by Benchmark::runCacheStates
+void printCacheStates(std::ostream& out, const std::vector<Benchmark::Results>& states, bool perImage);
+
+// Index of the fastest split, splits with errors only win when all of them have errors
+size_t bestThreadSplit(const std::vector<Benchmark::Results>& splits);
+void printThreadSplits(std::ostream& out, const std::vector<Benchmark::ThreadSplitGroup>& groups);
+
+// One row per configuration, aligned so that a whole sweep can be read at a glance
+void printSummary(std::ostream& out, const std::vector<ConfigurationResults>& allResults);
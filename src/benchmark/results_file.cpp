@@ -0,0 +1,525 @@
+#include "results_file.hpp"
+#include "json.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+// JSON has no NaN or infinity, e.g. the PSNR of a lossless image
+void writeJsonNumber(std::ostream& out, double value)
+{
+	if (std::isfinite(value))
+	{
+		out << value;
+	}
+	else
+	{
+		out << "null";
+	}
+}
+
+void writeJsonStatistics(std::ostream& out, const Statistics& statistics)
+{
+	out << "{\"min\":";
+	writeJsonNumber(out, statistics.min);
+	out << ",\"median\":";
+	writeJsonNumber(out, statistics.median);
+	out << ",\"mean\":";
+	writeJsonNumber(out, statistics.mean);
+	out << ",\"p90\":";
+	writeJsonNumber(out, statistics.p90);
+	out << ",\"p99\":";
+	writeJsonNumber(out, statistics.p99);
+	out << "}";
+}
+
+void writeJsonChannels(std::ostream& out, const double values[4], size_t channelCount)
+{
+	out << "[";
+	for (size_t i = 0; i < channelCount; ++i)
+	{
+		out << (i > 0 ? "," : "");
+		writeJsonNumber(out, values[i]);
+	}
+	out << "]";
+}
+
+void writeJsonQuality(std::ostream& out, const QualityMetrics& quality)
+{
+	out << "{";
+	auto first = true;
+	auto writeMetric = [&](const char* name, bool computed, const double values[4])
+	{
+		if (computed)
+		{
+			out << (first ? "" : ",") << "\"" << name << "\":";
+			writeJsonChannels(out, values, quality.channelCount);
+			first = false;
+		}
+	};
+	writeMetric("psnr", quality.computed.psnr, quality.psnr);
+	writeMetric("ssim", quality.computed.ssim, quality.ssim);
+	writeMetric("msssim", quality.computed.msssim, quality.msssim);
+	out << "}";
+}
+
+void writeJsonMemory(std::ostream& out, const MemoryUsage& memory)
+{
+	out << "{\"measurements\":" << memory.measurements;
+	out << ",\"peakResidentSetBytes\":" << memory.peakResidentSetBytes;
+	out << ",\"residentSetGrowthBytes\":" << memory.residentSetGrowthBytes;
+	out << ",\"allocationCount\":" << memory.allocationCount;
+	out << ",\"allocatedBytes\":" << memory.allocatedBytes << "}";
+}
+
+// null without readable RAPL counters
+void writeJsonEnergy(std::ostream& out, const EnergyUsage& energy, size_t bytesPerPass)
+{
+	if (!energy.available)
+	{
+		out << "null";
+		return;
+	}
+
+	out << "{\"passes\":" << energy.passes;
+	out << ",\"seconds\":";
+	writeJsonNumber(out, energy.seconds);
+	out << ",\"packageJoules\":";
+	writeJsonNumber(out, energy.packageJoules);
+	out << ",\"dramJoules\":";
+	if (energy.hasDram)
+	{
+		writeJsonNumber(out, energy.dramJoules);
+	}
+	else
+	{
+		out << "null";
+	}
+	out << ",\"joulesPerMegabyte\":";
+	writeJsonNumber(out, energy.joulesPerMegabyte(bytesPerPass));
+	out << ",\"averageWatts\":";
+	writeJsonNumber(out, energy.averageWatts());
+	out << "}";
+}
+
+// null unless the results come from --estimate
+void writeJsonInterval(std::ostream& out, const Benchmark::ConfidenceInterval& interval)
+{
+	if (!interval.available)
+	{
+		out << "null";
+		return;
+	}
+
+	out << "{\"secondsLow\":";
+	writeJsonNumber(out, interval.secondsLow);
+	out << ",\"secondsHigh\":";
+	writeJsonNumber(out, interval.secondsHigh);
+	out << ",\"errorLow\":";
+	writeJsonNumber(out, interval.errorLow);
+	out << ",\"errorHigh\":";
+	writeJsonNumber(out, interval.errorHigh);
+	out << "}";
+}
+
+void writeJsonExtrapolation(std::ostream& out, const Benchmark::Extrapolation& extrapolation)
+{
+	if (!extrapolation.applied)
+	{
+		out << "null";
+		return;
+	}
+
+	out << "{\"timedImages\":" << extrapolation.timedImages;
+	out << ",\"totalImages\":" << extrapolation.totalImages;
+	out << ",\"nanosecondsPerImage\":";
+	writeJsonNumber(out, extrapolation.nanosecondsPerImage);
+	out << ",\"nanosecondsPerPixel\":";
+	writeJsonNumber(out, extrapolation.nanosecondsPerPixel);
+	out << "}";
+}
+
+// null outside of latency mode
+void writeJsonStartup(std::ostream& out, const Benchmark::StartupLatency& startup)
+{
+	if (!startup.available)
+	{
+		out << "null";
+		return;
+	}
+
+	out << "{\"firstInProcess\":" << (startup.firstInProcess ? "true" : "false");
+	out << ",\"constructionSeconds\":";
+	writeJsonNumber(out, startup.constructionSeconds);
+	out << ",\"firstCompressSeconds\":";
+	writeJsonNumber(out, startup.firstCompressSeconds);
+	out << "}";
+}
+
+// Only the events the kernel let us count
+// Counters follow the calling threads only, threads of a codec allowed more than one are left out
+void writeJsonPerfCounters(std::ostream& out, const PerfCounterValues& counters, uint64_t blocks, bool callingThreadsOnly)
+{
+	out << "{\"measurements\":" << counters.measurements << ",\"blocks\":" << blocks;
+	out << ",\"callingThreadsOnly\":" << (callingThreadsOnly ? "true" : "false");
+	for (size_t i = 0; i < PerfEventCount; ++i)
+	{
+		auto event = static_cast<PerfEvent>(i);
+		if (counters.isAvailable(event))
+		{
+			out << ",";
+			writeJsonString(out, toString(event));
+			out << ":";
+			writeJsonNumber(out, counters.value(event));
+		}
+	}
+	out << "}";
+}
+
+// Source and decoded RGBA of the 4x4 block, row by row
+void writeJsonWorstBlock(std::ostream& out, const WorstBlock& block)
+{
+	out << "{\"x\":" << block.x << ",\"y\":" << block.y << ",\"error\":";
+	writeJsonNumber(out, block.error);
+	auto writePixels = [&](const char* name, const unsigned char* pixels)
+	{
+		out << ",\"" << name << "\":[";
+		for (size_t i = 0; i < 64; ++i)
+		{
+			out << (i > 0 ? "," : "") << static_cast<int>(pixels[i]);
+		}
+		out << "]";
+	};
+	writePixels("source", block.source);
+	writePixels("decoded", block.decoded);
+	out << "}";
+}
+
+void writeJsonImage(std::ostream& out, const Benchmark::ImageResults& image)
+{
+	out << "{\"name\":";
+	writeJsonString(out, image.name);
+	out << ",\"width\":" << image.width << ",\"height\":" << image.height;
+	out << ",\"elapsedNanoseconds\":";
+	writeJsonStatistics(out, image.elapsedNanoseconds);
+	out << ",\"cyclesPerBlock\":";
+	writeJsonNumber(out, image.cyclesPerBlock);
+	out << ",\"memory\":";
+	writeJsonMemory(out, image.memory);
+	out << ",\"blockErrorHistogram\":[";
+	for (size_t i = 0; i < BlockErrorHistogramSize; ++i)
+	{
+		out << (i > 0 ? "," : "") << image.blockErrors.histogram[i];
+	}
+	out << "],\"worstBlocks\":[";
+	for (size_t i = 0; i < image.blockErrors.worstBlocks.size(); ++i)
+	{
+		out << (i > 0 ? "," : "");
+		writeJsonWorstBlock(out, image.blockErrors.worstBlocks[i]);
+	}
+	out << "]}";
+}
+
+void writeJsonResult(std::ostream& out, const ConfigurationResults& entry)
+{
+	const auto& config = entry.config;
+	const auto& results = entry.results;
+
+	out << "{\"configuration\":";
+	writeJsonString(out, describe(config));
+	out << ",\"codec\":\"" << toString(config.codec) << "\"";
+	out << ",\"format\":\"" << toString(config.format) << "\"";
+	out << ",\"quality\":\"" << toString(config.quality) << "\"";
+	out << ",\"gpu\":" << (config.useGPU ? "true" : "false");
+	out << ",\"bc7Quick\":" << (config.bc7Quick ? "true" : "false");
+	out << ",\"bc7Use3Subsets\":" << (config.bc7Use3Subsets ? "true" : "false");
+
+	out << ",\"hasErrors\":" << (results.hasErrors ? "true" : "false");
+	out << ",\"processedBytes\":" << results.processedBytes;
+	out << ",\"elapsedSeconds\":";
+	writeJsonNumber(out, results.elapsedSeconds);
+	out << ",\"throughputBytesPerSec\":" << results.throughputBytesPerSec;
+	out << ",\"compressionError\":";
+	writeJsonNumber(out, results.compressionError);
+	out << ",\"threadCount\":" << results.threadCount;
+	out << ",\"codecThreadCount\":" << results.codecThreadCount;
+	out << ",\"peakResidentBytes\":" << results.peakResidentBytes;
+	out << ",\"nanosecondsPerBlock\":";
+	writeJsonNumber(out, results.nanosecondsPerBlock);
+	out << ",\"passNanoseconds\":";
+	writeJsonStatistics(out, results.passNanoseconds);
+	out << ",\"wallNanoseconds\":";
+	if (results.wallNanoseconds.median > 0.0)
+	{
+		writeJsonStatistics(out, results.wallNanoseconds);
+	}
+	else
+	{
+		out << "null";
+	}
+	out << ",\"qualityMetrics\":";
+	writeJsonQuality(out, results.quality);
+	out << ",\"perfCounters\":";
+	writeJsonPerfCounters(out, results.perfCounters, results.perfCounterBlocks, results.codecThreadCount != 1);
+	out << ",\"memory\":";
+	writeJsonMemory(out, results.memory);
+	out << ",\"energy\":";
+	writeJsonEnergy(out, results.energy, results.processedBytes);
+	out << ",\"startup\":";
+	writeJsonStartup(out, results.startup);
+	out << ",\"extrapolation\":";
+	writeJsonExtrapolation(out, results.extrapolation);
+	out << ",\"confidenceInterval\":";
+	writeJsonInterval(out, results.interval);
+
+	out << ",\"images\":[";
+	for (size_t i = 0; i < results.images.size(); ++i)
+	{
+		out << (i > 0 ? ",\n" : "\n");
+		writeJsonImage(out, results.images[i]);
+	}
+	out << "]}";
+}
+
+// Channel values of one metric in a single cell, e.g. "41.2/40.8/39.9"
+std::string formatChannels(bool computed, const double values[4], size_t channelCount)
+{
+	if (!computed)
+	{
+		return std::string();
+	}
+
+	std::ostringstream out;
+	out << std::setprecision(std::numeric_limits<double>::max_digits10);
+	for (size_t i = 0; i < channelCount; ++i)
+	{
+		out << (i > 0 ? "/" : "") << values[i];
+	}
+	return out.str();
+}
+
+void writeCsvStatistics(std::ostream& out, const Statistics& statistics)
+{
+	out << statistics.min << "," << statistics.median << "," << statistics.mean << "," << statistics.p90 << "," << statistics.p99;
+}
+
+// Quoted, with embedded quotes doubled
+void writeCsvString(std::ostream& out, const std::string& str)
+{
+	out << '"';
+	for (auto c : str)
+	{
+		out << (c == '"' ? "\"\"" : std::string(1, c));
+	}
+	out << '"';
+}
+
+// perf_ and the event name in lower case with underscores, e.g. perf_llc_misses
+std::string csvPerfColumn(PerfEvent event)
+{
+	std::string name = "perf_";
+	for (const char* c = toString(event); *c != '\0'; ++c)
+	{
+		name += *c == ' ' ? '_' : static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+	}
+	return name;
+}
+
+// Columns only the configuration rows fill in, empty when not measured
+const size_t CsvRunColumnCount = 2 + PerfEventCount + 1 + 4 + 4 + 4;
+
+void writeCsvRunHeader(std::ostream& out)
+{
+	out << "package_joules,dram_joules,";
+	for (size_t i = 0; i < PerfEventCount; ++i)
+	{
+		out << csvPerfColumn(static_cast<PerfEvent>(i)) << ",";
+	}
+	out << "perf_blocks,";
+	out << "first_in_process,construction_seconds,first_compress_seconds,steady_ns_median,";
+	out << "timed_images,total_images,extrapolated_ns_per_image,extrapolated_ns_per_pixel,";
+	out << "seconds_low,seconds_high,error_low,error_high";
+}
+
+void writeCsvRunColumns(std::ostream& out, const Benchmark::Results& results)
+{
+	const auto& energy = results.energy;
+	if (energy.available)
+	{
+		out << energy.packageJoules << ",";
+		if (energy.hasDram)
+		{
+			out << energy.dramJoules;
+		}
+	}
+	else
+	{
+		out << ",";
+	}
+	out << ",";
+
+	for (size_t i = 0; i < PerfEventCount; ++i)
+	{
+		auto event = static_cast<PerfEvent>(i);
+		if (results.perfCounters.isAvailable(event))
+		{
+			out << results.perfCounters.value(event);
+		}
+		out << ",";
+	}
+	if (results.perfCounters.measurements > 0)
+	{
+		out << results.perfCounterBlocks;
+	}
+	out << ",";
+
+	const auto& startup = results.startup;
+	if (startup.available)
+	{
+		out << startup.firstInProcess << "," << startup.constructionSeconds << "," << startup.firstCompressSeconds << ",";
+		out << results.passNanoseconds.median << ",";
+	}
+	else
+	{
+		out << ",,,,";
+	}
+
+	const auto& extrapolation = results.extrapolation;
+	if (extrapolation.applied)
+	{
+		out << extrapolation.timedImages << "," << extrapolation.totalImages << ",";
+		out << extrapolation.nanosecondsPerImage << "," << extrapolation.nanosecondsPerPixel << ",";
+	}
+	else
+	{
+		out << ",,,,";
+	}
+
+	const auto& interval = results.interval;
+	if (interval.available)
+	{
+		out << interval.secondsLow << "," << interval.secondsHigh << "," << interval.errorLow << "," << interval.errorHigh;
+	}
+	else
+	{
+		out << ",,,";
+	}
+}
+} // namespace
+
+bool writeJsonResults(const std::string& fileName, const RunDescription& run, const std::vector<ConfigurationResults>& allResults)
+{
+	std::ofstream out(fileName);
+	if (!out)
+	{
+		return false;
+	}
+
+	out << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+	const auto& settings = run.settings;
+	out << "{\"run\":{\"input\":";
+	writeJsonString(out, run.inputDir);
+	out << ",\"mode\":";
+	writeJsonString(out, run.mode);
+	out << ",\"warmupRuns\":" << settings.warmupRuns;
+	out << ",\"repetitions\":" << settings.repetitions;
+	out << ",\"threadCount\":" << settings.threadCount;
+	out << ",\"codecThreadCount\":" << settings.codecThreadCount;
+	out << ",\"pinnedCpus\":[";
+	for (size_t i = 0; i < settings.placement.cpus.size(); ++i)
+	{
+		out << (i > 0 ? "," : "") << settings.placement.cpus[i];
+	}
+	out << "],\"numa\":\"" << toString(settings.placement.numa) << "\"";
+	out << ",\"cacheState\":\"" << toString(settings.cacheState) << "\"";
+	out << ",\"timeBudgetSeconds\":";
+	writeJsonNumber(out, settings.timeBudgetSeconds);
+	out << ",\"pipelined\":" << (settings.pipelined ? "true" : "false");
+	out << ",\"memoryBudgetBytes\":" << settings.memoryBudgetBytes;
+	out << "},\n\"results\":[";
+	for (size_t i = 0; i < allResults.size(); ++i)
+	{
+		out << (i > 0 ? ",\n" : "\n");
+		writeJsonResult(out, allResults[i]);
+	}
+	out << "\n]}" << std::endl;
+
+	return static_cast<bool>(out);
+}
+
+bool writeCsvResults(const std::string& fileName, const std::vector<ConfigurationResults>& allResults)
+{
+	std::ofstream out(fileName);
+	if (!out)
+	{
+		return false;
+	}
+
+	out << std::setprecision(std::numeric_limits<double>::max_digits10);
+	out << "configuration,codec,format,quality,gpu,bc7quick,bc7use3subsets,image,width,height,";
+	out << "has_errors,processed_bytes,elapsed_seconds,throughput_bytes_per_sec,error,threads,codec_threads,peak_resident_bytes,ns_per_block,";
+	out << "ns_min,ns_median,ns_mean,ns_p90,ns_p99,cycles_per_block,";
+	out << "peak_rss_bytes,rss_growth_bytes,allocations,allocated_bytes,psnr,ssim,msssim,joules_per_mb,average_watts,wall_ns_median,";
+	writeCsvRunHeader(out);
+	out << std::endl;
+
+	for (const auto& entry : allResults)
+	{
+		const auto& config = entry.config;
+		const auto& results = entry.results;
+		const auto& quality = results.quality;
+
+		std::ostringstream prefix;
+		writeCsvString(prefix, describe(config));
+		prefix << "," << toString(config.codec) << "," << toString(config.format) << ",";
+		prefix << toString(config.quality) << "," << config.useGPU << "," << config.bc7Quick << "," << config.bc7Use3Subsets << ",";
+
+		out << prefix.str() << ",,,";
+		out << results.hasErrors << "," << results.processedBytes << "," << results.elapsedSeconds << ",";
+		out << results.throughputBytesPerSec << "," << results.compressionError << "," << results.threadCount << "," << results.codecThreadCount << ",";
+		out << results.peakResidentBytes << "," << results.nanosecondsPerBlock << ",";
+		writeCsvStatistics(out, results.passNanoseconds);
+		out << ",,";
+		out << results.memory.peakResidentSetBytes << "," << results.memory.residentSetGrowthBytes << ",";
+		out << results.memory.allocationCount << "," << results.memory.allocatedBytes << ",";
+		out << formatChannels(quality.computed.psnr, quality.psnr, quality.channelCount) << ",";
+		out << formatChannels(quality.computed.ssim, quality.ssim, quality.channelCount) << ",";
+		out << formatChannels(quality.computed.msssim, quality.msssim, quality.channelCount) << ",";
+		if (results.energy.available)
+		{
+			out << results.energy.joulesPerMegabyte(results.processedBytes) << "," << results.energy.averageWatts();
+		}
+		else
+		{
+			out << ",";
+		}
+		out << ",";
+		if (results.wallNanoseconds.median > 0.0)
+		{
+			out << results.wallNanoseconds.median;
+		}
+		out << ",";
+		writeCsvRunColumns(out, results);
+		out << std::endl;
+
+		for (const auto& image : results.images)
+		{
+			out << prefix.str();
+			writeCsvString(out, image.name);
+			out << "," << image.width << "," << image.height << ",";
+			out << ",,,,,,,,,";
+			writeCsvStatistics(out, image.elapsedNanoseconds);
+			out << "," << image.cyclesPerBlock << ",";
+			out << image.memory.peakResidentSetBytes << "," << image.memory.residentSetGrowthBytes << ",";
+			out << image.memory.allocationCount << "," << image.memory.allocatedBytes << ",,,,,," << std::string(CsvRunColumnCount, ',') << std::endl;
+		}
+	}
+
+	return static_cast<bool>(out);
+}
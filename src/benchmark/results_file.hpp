@@ -0,0 +1,23 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "report.hpp"
+
+#include <string>
+#include <vector>
+
+// Run-wide settings, stored next to the results so that files from different runs can be told apart
+struct RunDescription
+{
+	std::string inputDir;
+	std::string mode;
+	Benchmark::Settings settings;
+};
+
+// Every field of every result including per-image data. Results are keyed by their
+// "configuration" member, which is describe(config), so that a later run can find them.
+bool writeJsonResults(const std::string& fileName, const RunDescription& run, const std::vector<ConfigurationResults>& allResults);
+
+// One row per configuration with the whole data set, followed by one row per image.
+// Columns that only exist for one kind of row are left empty in the other.
+bool writeCsvResults(const std::string& fileName, const std::vector<ConfigurationResults>& allResults);
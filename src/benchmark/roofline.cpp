@@ -0,0 +1,302 @@
+#include "roofline.hpp"
+#include "block_decoder.hpp"
+#include "parallel.hpp"
+#include "perf_counters.hpp"
+#include "timing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+// Far beyond any last level cache, so that every pass streams from memory
+const size_t BufferBytes = size_t(256) << 20;
+const size_t KernelRuns = 3;
+const size_t ComputeIterations = 20000000;
+const size_t ComputeChains = 8;
+
+// Results of the kernels end up here so that they aren't optimized away
+volatile uint64_t g_sink = 0;
+
+uint64_t sumWords(const uint64_t* words, size_t count)
+{
+	uint64_t sums[4] = {};
+	for (size_t i = 0; i + 4 <= count; i += 4)
+	{
+		sums[0] += words[i];
+		sums[1] += words[i + 1];
+		sums[2] += words[i + 2];
+		sums[3] += words[i + 3];
+	}
+
+	return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+// Independent chains of two dependent operations each, more work per cycle than the
+// integer units can issue. The iteration feeds in so that no chain has a closed form.
+uint64_t integerOperations(uint64_t seed, size_t iterations)
+{
+	uint64_t chains[ComputeChains];
+	for (size_t i = 0; i < ComputeChains; ++i)
+	{
+		chains[i] = seed + i;
+	}
+
+	for (size_t n = 0; n < iterations; ++n)
+	{
+		for (size_t i = 0; i < ComputeChains; ++i)
+		{
+			chains[i] = (chains[i] ^ n) + i + 1;
+		}
+	}
+
+	uint64_t result = 0;
+	for (auto chain : chains)
+	{
+		result ^= chain;
+	}
+
+	return result;
+}
+
+// Best rate of a few runs of kernel(threadIndex) on threadCount threads, which together move bytes
+template <typename Kernel>
+double bestBytesPerSecond(size_t threadCount, size_t bytes, Kernel&& kernel)
+{
+	double best = 0.0;
+	for (size_t run = 0; run < KernelRuns; ++run)
+	{
+		auto start = Clock::now();
+		runOnThreads(threadCount, kernel);
+		auto end = Clock::now();
+
+		auto nanoseconds = elapsedNanoseconds(start, end);
+		if (nanoseconds > 0)
+		{
+			best = std::max(best, bytes * 1e9 / nanoseconds);
+		}
+	}
+
+	return best;
+}
+
+StreamingBandwidth measureBandwidth(size_t threadCount)
+{
+	auto wordCount = BufferBytes / sizeof(uint64_t);
+	std::unique_ptr<uint64_t[]> buffer(new uint64_t[wordCount]);
+	auto words = buffer.get();
+
+	auto slice = [&](size_t threadIndex, size_t count, size_t& begin, size_t& end)
+	{
+		begin = count * threadIndex / threadCount;
+		end = count * (threadIndex + 1) / threadCount;
+	};
+
+	// Writing first makes every thread first touch the slice it streams later on,
+	// the page faults of the first run are left out by taking the best run
+	StreamingBandwidth bandwidth;
+	bandwidth.writeBytesPerSec = bestBytesPerSecond(threadCount, BufferBytes, [&](size_t threadIndex)
+	{
+		size_t begin, end;
+		slice(threadIndex, wordCount, begin, end);
+		std::fill(words + begin, words + end, threadIndex + 1);
+	});
+
+	bandwidth.readBytesPerSec = bestBytesPerSecond(threadCount, BufferBytes, [&](size_t threadIndex)
+	{
+		size_t begin, end;
+		slice(threadIndex, wordCount, begin, end);
+		g_sink = g_sink + sumWords(words + begin, end - begin);
+	});
+
+	// Half of the buffer to the other half, so every thread copies within its slice
+	auto halfWords = wordCount / 2;
+	bandwidth.copyBytesPerSec = bestBytesPerSecond(threadCount, halfWords * sizeof(uint64_t), [&](size_t threadIndex)
+	{
+		size_t begin, end;
+		slice(threadIndex, wordCount, begin, end);
+		auto half = (end - begin) / 2;
+		std::memcpy(words + begin + half, words + begin, half * sizeof(uint64_t));
+	});
+
+	return bandwidth;
+}
+
+double measureCyclesPerSecond()
+{
+	auto startTime = Clock::now();
+	auto startCycles = readCycleCounter();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	auto endCycles = readCycleCounter();
+	auto endTime = Clock::now();
+
+	return (endCycles - startCycles) * 1e9 / elapsedNanoseconds(startTime, endTime);
+}
+
+// Instructions counted by hardware counters where available, otherwise the operations of the chains,
+// over reference cycles so that the floor comes out in the unit of the other columns
+double measurePeakInstructionsPerCycle(bool& counted)
+{
+	PerfCounters counters;
+	double best = 0.0;
+	counted = true;
+	for (size_t run = 0; run < KernelRuns; ++run)
+	{
+		PerfCounterValues values;
+		counters.start();
+		auto startCycles = readCycleCounter();
+		g_sink = g_sink + integerOperations(run, ComputeIterations);
+		auto endCycles = readCycleCounter();
+		counters.stop(values);
+
+		counted = counted && values.isAvailable(PerfEvent::Cycles) && values.isAvailable(PerfEvent::Instructions);
+		auto instructions = counted ? values.value(PerfEvent::Instructions) : 2.0 * ComputeChains * ComputeIterations;
+		best = std::max(best, instructions / static_cast<double>(endCycles - startCycles));
+	}
+
+	return best;
+}
+
+// Blocks of a codec left to its own threading may have kept the whole machine busy
+size_t activeThreads(const Benchmark::Results& results)
+{
+	auto codecThreads = results.codecThreadCount > 0 ? results.codecThreadCount : hardwareThreadCount();
+	return std::max<size_t>(1, std::min(results.threadCount * codecThreads, hardwareThreadCount()));
+}
+} // namespace
+
+Roofline::Roofline(size_t threadCount)
+{
+	m_cyclesPerSecond = measureCyclesPerSecond();
+	m_peakInstructionsPerCycle = measurePeakInstructionsPerCycle(m_countedPeak);
+	bandwidth(1);
+	bandwidth(std::max<size_t>(threadCount, 1));
+}
+
+const StreamingBandwidth& Roofline::bandwidth(size_t threadCount)
+{
+	auto found = m_bandwidths.find(threadCount);
+	if (found == m_bandwidths.end())
+	{
+		found = m_bandwidths.emplace(threadCount, measureBandwidth(threadCount)).first;
+	}
+
+	return found->second;
+}
+
+std::vector<RooflinePoint> placeOnRoofline(Roofline& roofline, const std::vector<ConfigurationResults>& allResults)
+{
+	std::vector<RooflinePoint> points;
+	for (size_t i = 0; i < allResults.size(); ++i)
+	{
+		const auto& results = allResults[i].results;
+		if (results.hasErrors || results.nanosecondsPerBlock <= 0.0)
+		{
+			continue;
+		}
+
+		RooflinePoint point;
+		point.resultIndex = i;
+		point.activeThreads = activeThreads(results);
+
+		auto compressedBytes = blockSize(allResults[i].config.format);
+		point.bytesPerBlock = 64 + compressedBytes;
+
+		// Wall time per block of all active threads, counted as the core time of each of them
+		const auto& bandwidth = roofline.bandwidth(point.activeThreads);
+		auto coreCyclesPerSecond = roofline.cyclesPerSecond() * point.activeThreads;
+		auto floorSeconds = (bandwidth.readBytesPerSec > 0.0 ? 64 / bandwidth.readBytesPerSec : 0.0) +
+			(bandwidth.writeBytesPerSec > 0.0 ? compressedBytes / bandwidth.writeBytesPerSec : 0.0);
+		point.cyclesPerBlock = results.nanosecondsPerBlock * 1e-9 * coreCyclesPerSecond;
+		point.memoryFloorCycles = floorSeconds * coreCyclesPerSecond;
+
+		// Counters cover the calling threads only, so with codec threads of its own the instructions
+		// of a configuration are incomplete and its floor would be too low
+		point.hasInstructions = results.codecThreadCount == 1 && results.perfCounters.isAvailable(PerfEvent::Instructions) &&
+			results.perfCounterBlocks > 0 && roofline.peakInstructionsPerCycle() > 0.0;
+		point.instructionsPerBlock = point.hasInstructions ? results.perfCounters.value(PerfEvent::Instructions) / results.perfCounterBlocks : 0.0;
+		point.computeFloorCycles = point.hasInstructions ? point.instructionsPerBlock / roofline.peakInstructionsPerCycle() : 0.0;
+
+		// Without an instruction count there is no compute floor to hold the memory floor against
+		point.bound = !point.hasInstructions ? RooflineBound::Unknown :
+			point.memoryFloorCycles >= point.computeFloorCycles ? RooflineBound::Memory : RooflineBound::Compute;
+
+		points.push_back(point);
+	}
+
+	return points;
+}
+
+const char* toString(RooflineBound bound)
+{
+	switch (bound)
+	{
+	case RooflineBound::Memory:
+		return "memory";
+	case RooflineBound::Compute:
+		return "compute";
+	default:
+		return "unknown";
+	}
+}
+
+void printRooflinePeaks(std::ostream& out, const Roofline& roofline)
+{
+	out << "Roofline: reference clock " << std::fixed << std::setprecision(2) << roofline.cyclesPerSecond() * 1e-9 << " GHz, ";
+	out << "compute peak " << roofline.peakInstructionsPerCycle();
+	out << (roofline.hasCountedPeak() ? " instructions" : " operations") << "/reference cycle on one core" << std::endl;
+
+	for (const auto& entry : roofline.measuredBandwidths())
+	{
+		const auto& bandwidth = entry.second;
+		out << "Bandwidth with " << entry.first << (entry.first == 1 ? " thread" : " threads") << "\t\t";
+		out << "Read " << formatBytes(static_cast<size_t>(bandwidth.readBytesPerSec)) << "/sec\t\t";
+		out << "Write " << formatBytes(static_cast<size_t>(bandwidth.writeBytesPerSec)) << "/sec\t\t";
+		out << "Copy " << formatBytes(static_cast<size_t>(bandwidth.copyBytesPerSec)) << "/sec" << std::endl;
+	}
+}
+
+void printRoofline(std::ostream& out, const std::vector<RooflinePoint>& points, const std::vector<ConfigurationResults>& allResults)
+{
+	if (points.empty())
+	{
+		return;
+	}
+
+	size_t width = 0;
+	for (const auto& point : points)
+	{
+		width = std::max(width, describe(allResults[point.resultIndex].config).size());
+	}
+
+	out << std::endl << "Roofline, reference cycles of core time per block" << std::endl;
+	out << std::left << std::setw(width + 2) << "Configuration";
+	out << std::right << std::setw(9) << "Threads";
+	out << std::setw(14) << "Bytes/block";
+	out << std::setw(14) << "Cycles/block";
+	out << std::setw(22) << "Memory floor";
+	out << std::setw(22) << "Compute floor";
+	out << "  Bound" << std::endl;
+
+	auto formatFloor = [](double floor, double cycles)
+	{
+		std::stringstream buffer;
+		buffer << std::fixed << std::setprecision(1) << floor << " (" << (cycles > 0.0 ? 100.0 * floor / cycles : 0.0) << "%)";
+		return buffer.str();
+	};
+
+	for (const auto& point : points)
+	{
+		out << std::left << std::setw(width + 2) << describe(allResults[point.resultIndex].config);
+		out << std::right << std::setw(9) << point.activeThreads;
+		out << std::setw(14) << point.bytesPerBlock;
+		out << std::fixed << std::setprecision(1) << std::setw(14) << point.cyclesPerBlock;
+		out << std::setw(22) << formatFloor(point.memoryFloorCycles, point.cyclesPerBlock);
+		out << std::setw(22) << (point.hasInstructions ? formatFloor(point.computeFloorCycles, point.cyclesPerBlock) : "-");
+		out << "  " << toString(point.bound) << std::endl;
+	}
+}
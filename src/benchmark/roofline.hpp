@@ -0,0 +1,77 @@
+#pragma once
+
+#include "report.hpp"
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+// Achievable streaming bandwidth of a number of threads, each thread on its own slice of a buffer
+// much larger than any last level cache
+struct StreamingBandwidth
+{
+	double readBytesPerSec = 0.0;
+	double writeBytesPerSec = 0.0;
+	// Bytes copied, each of which is read and written
+	double copyBytesPerSec = 0.0;
+};
+
+// Peaks of the machine measured with built-in kernels, best of a few runs each
+class Roofline final
+{
+public:
+	// Measures the compute peak and the bandwidth of one thread and of threadCount threads
+	Roofline(size_t threadCount);
+
+	// Reference cycles per second, those of readCycleCounter()
+	double cyclesPerSecond() const { return m_cyclesPerSecond; }
+	// Instructions per reference cycle of a kernel of independent integer operations on one core.
+	// Without hardware counters it's the operations of the kernel, with its loop left out.
+	double peakInstructionsPerCycle() const { return m_peakInstructionsPerCycle; }
+	bool hasCountedPeak() const { return m_countedPeak; }
+
+	// Measured on first use for thread counts other than those of the constructor
+	const StreamingBandwidth& bandwidth(size_t threadCount);
+	const std::map<size_t, StreamingBandwidth>& measuredBandwidths() const { return m_bandwidths; }
+
+private:
+	double m_cyclesPerSecond = 0.0;
+	double m_peakInstructionsPerCycle = 0.0;
+	bool m_countedPeak = false;
+	std::map<size_t, StreamingBandwidth> m_bandwidths;
+};
+
+enum class RooflineBound
+{
+	Memory,
+	Compute,
+	// Without an instruction count
+	Unknown
+};
+
+const char* toString(RooflineBound bound);
+
+// One configuration on the roofline, in reference cycles of core time per 4x4 block
+struct RooflinePoint
+{
+	size_t resultIndex;
+	// Threads the configuration may have kept busy, those of the bandwidth roof it is held against
+	size_t activeThreads;
+	// The uncompressed block read and the compressed block written, the least a codec can move
+	size_t bytesPerBlock;
+	double cyclesPerBlock;
+	// Cycles per block if the codec did nothing but stream its blocks at the measured bandwidth
+	double memoryFloorCycles;
+	// Instructions per block over the peak rate, only with Settings::perfCounters and a codec
+	// kept to the calling thread, as the counters don't follow threads of the codec
+	bool hasInstructions;
+	double instructionsPerBlock;
+	double computeFloorCycles;
+	RooflineBound bound;
+};
+
+// Configurations with errors or without a block time are left out
+std::vector<RooflinePoint> placeOnRoofline(Roofline& roofline, const std::vector<ConfigurationResults>& allResults);
+
+void printRooflinePeaks(std::ostream& out, const Roofline& roofline);
+void printRoofline(std::ostream& out, const std::vector<RooflinePoint>& points, const std::vector<ConfigurationResults>& allResults);
@@ -0,0 +1,520 @@
+#include "soak.hpp"
+#include "report.hpp"
+#include "svg_chart.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <powerbase.h>
+#endif
+
+namespace
+{
+// Rounds at the start and the end that the medians are taken over
+const size_t EdgeRounds = 3;
+
+#if defined(_WIN32)
+// Documented but not declared in the SDK headers
+struct ProcessorPowerInformation
+{
+	ULONG Number;
+	ULONG MaxMhz;
+	ULONG CurrentMhz;
+	ULONG MhzLimit;
+	ULONG MaxIdleState;
+	ULONG CurrentIdleState;
+};
+
+std::vector<double> readCoreFrequencies()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	std::vector<ProcessorPowerInformation> processors(info.dwNumberOfProcessors);
+	auto size = static_cast<ULONG>(processors.size() * sizeof(ProcessorPowerInformation));
+	if (CallNtPowerInformation(ProcessorInformation, nullptr, 0, processors.data(), size) != 0)
+	{
+		return {};
+	}
+
+	std::vector<double> frequencies;
+	for (const auto& processor : processors)
+	{
+		frequencies.push_back(processor.CurrentMhz);
+	}
+	return frequencies;
+}
+
+double readMaxTemperature()
+{
+	return std::numeric_limits<double>::quiet_NaN();
+}
+#elif defined(__linux__)
+bool readNumber(const std::string& path, double& value)
+{
+	std::ifstream in(path);
+	return static_cast<bool>(in >> value);
+}
+
+// scaling_cur_freq is in kHz, offline CPUs and CPUs without cpufreq are left out
+std::vector<double> readCoreFrequencies()
+{
+	std::vector<double> frequencies;
+	for (size_t cpu = 0; ; ++cpu)
+	{
+		auto dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+		std::error_code error;
+		if (!std::filesystem::exists(dir, error))
+		{
+			break;
+		}
+
+		double kilohertz;
+		if (readNumber(dir + "/cpufreq/scaling_cur_freq", kilohertz))
+		{
+			frequencies.push_back(kilohertz / 1000.0);
+		}
+	}
+
+	return frequencies;
+}
+
+// Zone temperatures are in millidegrees Celsius
+double readMaxTemperature()
+{
+	auto maxTemperature = std::numeric_limits<double>::quiet_NaN();
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator("/sys/class/thermal", error))
+	{
+		double millidegrees;
+		if (entry.path().filename().string().compare(0, 12, "thermal_zone") == 0 && readNumber(entry.path().string() + "/temp", millidegrees))
+		{
+			auto celsius = millidegrees / 1000.0;
+			maxTemperature = std::isnan(maxTemperature) ? celsius : std::max(maxTemperature, celsius);
+		}
+	}
+
+	return maxTemperature;
+}
+#else
+std::vector<double> readCoreFrequencies()
+{
+	return {};
+}
+
+double readMaxTemperature()
+{
+	return std::numeric_limits<double>::quiet_NaN();
+}
+#endif
+
+double median(std::vector<double> values)
+{
+	if (values.empty())
+	{
+		return 0.0;
+	}
+
+	std::sort(std::begin(values), std::end(values));
+	auto middle = values.size() / 2;
+	return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+}
+
+// Skips the first round, which warms up caches and the codec, when there are enough rounds to spare it
+template <typename Value>
+double startMedian(const std::vector<SoakSample>& samples, Value&& value)
+{
+	auto first = samples.size() > EdgeRounds + 1 ? size_t(1) : size_t(0);
+	std::vector<double> values;
+	for (auto i = first; i < std::min(samples.size(), first + EdgeRounds); ++i)
+	{
+		values.push_back(value(samples[i]));
+	}
+	return median(values);
+}
+
+template <typename Value>
+double endMedian(const std::vector<SoakSample>& samples, Value&& value)
+{
+	std::vector<double> values;
+	for (auto i = samples.size() - std::min(samples.size(), EdgeRounds); i < samples.size(); ++i)
+	{
+		values.push_back(value(samples[i]));
+	}
+	return median(values);
+}
+
+// Start of the first run of rounds below the limit that lasts for EdgeRounds rounds or until the end
+template <typename Value>
+bool findDrop(const std::vector<SoakSample>& samples, double limit, Value&& value, double& onsetSeconds)
+{
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		auto end = std::min(samples.size(), i + EdgeRounds);
+		auto below = true;
+		for (auto j = i; j < end && below; ++j)
+		{
+			below = value(samples[j]) < limit;
+		}
+
+		if (below)
+		{
+			onsetSeconds = samples[i].seconds - samples[i].roundSeconds;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void writeCsv(std::ostream& out, const std::vector<SoakSample>& samples)
+{
+	size_t coreCount = 0;
+	for (const auto& sample : samples)
+	{
+		coreCount = std::max(coreCount, sample.coreFrequenciesMHz.size());
+	}
+
+	out << "seconds,round_seconds,throughput_bytes_per_sec,mean_mhz,temperature_c,resident_set_bytes";
+	for (size_t i = 0; i < coreCount; ++i)
+	{
+		out << ",core" << i << "_mhz";
+	}
+	out << std::endl;
+
+	for (const auto& sample : samples)
+	{
+		out << sample.seconds << "," << sample.roundSeconds << "," << sample.throughputBytesPerSec << ",";
+		out << sample.meanFrequencyMHz() << ",";
+		if (!std::isnan(sample.temperatureCelsius))
+		{
+			out << sample.temperatureCelsius;
+		}
+		out << "," << sample.residentSetBytes;
+		for (size_t i = 0; i < coreCount; ++i)
+		{
+			out << ",";
+			if (i < sample.coreFrequenciesMHz.size())
+			{
+				out << sample.coreFrequenciesMHz[i];
+			}
+		}
+		out << std::endl;
+	}
+}
+
+// Both series as a percentage of their start so that they share an axis
+void writeSvg(std::ostream& out, const std::string& name, const std::vector<SoakSample>& samples, const SoakReport& report)
+{
+	const SvgChart chart = { 900.0, 500.0, 70.0, 160.0, 40.0, 60.0 };
+
+	auto relativeThroughput = [&](const SoakSample& sample)
+	{
+		return report.startThroughput > 0.0 ? sample.throughputBytesPerSec / report.startThroughput * 100.0 : 0.0;
+	};
+	auto relativeFrequency = [&](const SoakSample& sample)
+	{
+		return report.startFrequencyMHz > 0.0 ? sample.meanFrequencyMHz() / report.startFrequencyMHz * 100.0 : 0.0;
+	};
+
+	auto maxSeconds = samples.empty() ? 1.0 : std::max(samples.back().seconds, 1.0);
+	auto maxPercent = 110.0;
+	for (const auto& sample : samples)
+	{
+		maxPercent = std::max({ maxPercent, relativeThroughput(sample), relativeFrequency(sample) });
+	}
+	maxPercent = std::ceil(maxPercent / 10.0) * 10.0;
+
+	auto x = [&](double seconds) { return chart.left + seconds / maxSeconds * chart.plotWidth(); };
+	auto y = [&](double percent) { return chart.top + (maxPercent - percent) / maxPercent * chart.plotHeight(); };
+
+	writeSvgChartStart(out, chart, name + " soak, relative to the start");
+	for (size_t i = 0; i <= 5; ++i)
+	{
+		auto seconds = maxSeconds * i / 5.0;
+		out << "<text x=\"" << x(seconds) << "\" y=\"" << chart.height - chart.bottom + 18 << "\" text-anchor=\"middle\">" << std::setprecision(0) << seconds << " s</text>" << std::endl;
+	}
+	for (auto percent = 0.0; percent <= maxPercent; percent += 20.0)
+	{
+		out << "<text x=\"" << chart.left - 6 << "\" y=\"" << y(percent) + 4 << "\" text-anchor=\"end\">" << percent << "%</text>" << std::endl;
+	}
+	out << std::setprecision(1);
+	out << "<line x1=\"" << chart.left << "\" y1=\"" << y(100.0) << "\" x2=\"" << chart.width - chart.right << "\" y2=\"" << y(100.0) << "\" stroke=\"#cccccc\"/>" << std::endl;
+	out << "<text x=\"" << (chart.left + chart.width - chart.right) / 2 << "\" y=\"" << chart.height - 15 << "\" text-anchor=\"middle\">time</text>" << std::endl;
+
+	auto writeSeries = [&](const char* label, const char* color, double labelY, auto&& value)
+	{
+		std::string path;
+		for (const auto& sample : samples)
+		{
+			addSvgPathPoint(path, x(sample.seconds), y(value(sample)));
+		}
+		writeSvgPath(out, path, color);
+		out << "<text x=\"" << chart.width - chart.right + 10 << "\" y=\"" << labelY << "\" fill=\"" << color << "\">" << label << "</text>" << std::endl;
+	};
+	writeSeries("throughput", "#1f77b4", chart.top + 10, relativeThroughput);
+	if (report.startFrequencyMHz > 0.0)
+	{
+		writeSeries("mean frequency", "#ff7f0e", chart.top + 26, relativeFrequency);
+	}
+
+	if (report.throughputThrottled)
+	{
+		auto onsetX = x(report.throughputThrottleSeconds);
+		out << "<line x1=\"" << onsetX << "\" y1=\"" << chart.top << "\" x2=\"" << onsetX << "\" y2=\"" << chart.height - chart.bottom << "\" stroke=\"#d62728\" stroke-dasharray=\"4,3\"/>" << std::endl;
+		out << "<text x=\"" << chart.width - chart.right + 10 << "\" y=\"" << chart.top + 42 << "\" fill=\"#d62728\">throttling onset</text>" << std::endl;
+	}
+
+	writeSvgChartEnd(out);
+}
+} // namespace
+
+double SoakSample::meanFrequencyMHz() const
+{
+	if (coreFrequenciesMHz.empty())
+	{
+		return 0.0;
+	}
+
+	double sum = 0.0;
+	for (auto frequency : coreFrequenciesMHz)
+	{
+		sum += frequency;
+	}
+	return sum / coreFrequenciesMHz.size();
+}
+
+bool parseDuration(const std::string& str, double& seconds)
+{
+	size_t end = 0;
+	try
+	{
+		seconds = std::stod(str, &end);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	auto unit = str.substr(end);
+	if (unit == "h")
+	{
+		seconds *= 3600.0;
+	}
+	else if (unit == "m")
+	{
+		seconds *= 60.0;
+	}
+	else if (!unit.empty() && unit != "s")
+	{
+		return false;
+	}
+
+	return seconds > 0.0;
+}
+
+SoakReport analyzeSoak(const std::vector<SoakSample>& samples, const SoakSettings& settings)
+{
+	SoakReport report;
+	if (samples.empty())
+	{
+		return report;
+	}
+
+	auto throughput = [](const SoakSample& sample) { return sample.throughputBytesPerSec; };
+	auto frequency = [](const SoakSample& sample) { return sample.meanFrequencyMHz(); };
+
+	report.startThroughput = startMedian(samples, throughput);
+	report.endThroughput = endMedian(samples, throughput);
+	report.startFrequencyMHz = startMedian(samples, frequency);
+	report.endFrequencyMHz = endMedian(samples, frequency);
+
+	report.maxTemperatureCelsius = std::numeric_limits<double>::quiet_NaN();
+	for (const auto& sample : samples)
+	{
+		if (!std::isnan(sample.temperatureCelsius))
+		{
+			report.maxTemperatureCelsius = std::isnan(report.maxTemperatureCelsius) ?
+				sample.temperatureCelsius : std::max(report.maxTemperatureCelsius, sample.temperatureCelsius);
+		}
+	}
+
+	auto keep = 1.0 - settings.throttleThreshold;
+	report.throughputThrottled = findDrop(samples, report.startThroughput * keep, throughput, report.throughputThrottleSeconds);
+	report.frequencyThrottled = report.startFrequencyMHz > 0.0 &&
+		findDrop(samples, report.startFrequencyMHz * keep, frequency, report.frequencyThrottleSeconds);
+
+	// The first round allocates the codec's and the benchmark's buffers, growth is measured from its end
+	report.startResidentSetBytes = samples.front().residentSetBytes;
+	report.endResidentSetBytes = samples.back().residentSetBytes;
+	auto growth = report.endResidentSetBytes > report.startResidentSetBytes ? report.endResidentSetBytes - report.startResidentSetBytes : 0;
+	report.residentGrowing = growth > settings.residentGrowthBytes && growth > report.startResidentSetBytes * settings.residentGrowthFraction;
+
+	if (samples.size() > 2)
+	{
+		double meanX = 0.0;
+		double meanY = 0.0;
+		for (size_t i = 1; i < samples.size(); ++i)
+		{
+			meanX += samples[i].seconds;
+			meanY += static_cast<double>(samples[i].residentSetBytes);
+		}
+		meanX /= samples.size() - 1;
+		meanY /= samples.size() - 1;
+
+		double covariance = 0.0;
+		double variance = 0.0;
+		for (size_t i = 1; i < samples.size(); ++i)
+		{
+			covariance += (samples[i].seconds - meanX) * (samples[i].residentSetBytes - meanY);
+			variance += (samples[i].seconds - meanX) * (samples[i].seconds - meanX);
+		}
+		report.residentSlopeBytesPerMinute = variance > 0.0 ? covariance / variance * 60.0 : 0.0;
+	}
+
+	return report;
+}
+
+void printSoakReport(std::ostream& out, const std::vector<SoakSample>& samples, const SoakReport& report)
+{
+	if (samples.empty())
+	{
+		return;
+	}
+
+	out << "Rounds " << samples.size() << " in " << std::fixed << std::setprecision(1) << samples.back().seconds << " sec\t\t";
+	out << "Throughput " << formatBytes(static_cast<size_t>(report.startThroughput)) << "/sec at the start, ";
+	out << formatBytes(static_cast<size_t>(report.endThroughput)) << "/sec at the end" << std::endl;
+
+	if (report.startFrequencyMHz > 0.0)
+	{
+		out << "Mean frequency " << std::setprecision(0) << report.startFrequencyMHz << " MHz at the start, " << report.endFrequencyMHz << " MHz at the end\t\t";
+	}
+	else
+	{
+		out << "Frequency not available\t\t";
+	}
+	if (!std::isnan(report.maxTemperatureCelsius))
+	{
+		out << "Peak temperature " << std::setprecision(1) << report.maxTemperatureCelsius << " C";
+	}
+	else
+	{
+		out << "Temperature not available";
+	}
+	out << std::endl;
+
+	if (report.throughputThrottled)
+	{
+		out << "Throughput throttled from " << std::setprecision(1) << report.throughputThrottleSeconds << " sec" << std::endl;
+	}
+	if (report.frequencyThrottled)
+	{
+		out << "Frequency throttled from " << std::setprecision(1) << report.frequencyThrottleSeconds << " sec" << std::endl;
+	}
+
+	out << "Resident set " << formatBytes(report.startResidentSetBytes) << " after the first round, " << formatBytes(report.endResidentSetBytes) << " at the end, ";
+	out << (report.residentSlopeBytesPerMinute < 0.0 ? "-" : "") << formatBytes(static_cast<size_t>(std::abs(report.residentSlopeBytesPerMinute))) << "/min";
+	if (report.residentGrowing)
+	{
+		out << "\t\tgrowing, possible leak";
+	}
+	out << std::endl;
+}
+
+bool writeSoakChart(const std::string& dir, const std::string& name, const std::vector<SoakSample>& samples, const SoakReport& report)
+{
+	std::error_code error;
+	std::filesystem::create_directories(dir, error);
+
+	auto fileName = name;
+	std::replace(std::begin(fileName), std::end(fileName), ' ', '_');
+	auto base = (std::filesystem::path(dir) / ("soak_" + fileName)).string();
+
+	std::ofstream csv(base + ".csv");
+	std::ofstream svg(base + ".svg");
+	if (!csv || !svg)
+	{
+		return false;
+	}
+
+	writeCsv(csv, samples);
+	writeSvg(svg, name, samples, report);
+	return csv && svg;
+}
+
+SystemMonitor::SystemMonitor(double intervalSeconds)
+	: m_maxTemperature(std::numeric_limits<double>::quiet_NaN())
+{
+	auto interval = std::chrono::duration<double>(intervalSeconds);
+	m_thread = std::thread([this, interval]()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stopping)
+		{
+			lock.unlock();
+			poll();
+			lock.lock();
+			m_wake.wait_for(lock, interval, [this]() { return m_stopping; });
+		}
+	});
+}
+
+SystemMonitor::~SystemMonitor()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+}
+
+void SystemMonitor::poll()
+{
+	// Reading sysfs takes a while, only the accumulation happens under the lock
+	auto frequencies = readCoreFrequencies();
+	auto temperature = readMaxTemperature();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_frequencySums.resize(std::max(m_frequencySums.size(), frequencies.size()), 0.0);
+	for (size_t i = 0; i < frequencies.size(); ++i)
+	{
+		m_frequencySums[i] += frequencies[i];
+	}
+	if (!std::isnan(temperature))
+	{
+		m_maxTemperature = std::isnan(m_maxTemperature) ? temperature : std::max(m_maxTemperature, temperature);
+	}
+	++m_polls;
+}
+
+void SystemMonitor::collect(SoakSample& sample)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_polls > 0)
+		{
+			sample.coreFrequenciesMHz.clear();
+			for (auto sum : m_frequencySums)
+			{
+				sample.coreFrequenciesMHz.push_back(sum / m_polls);
+			}
+			sample.temperatureCelsius = m_maxTemperature;
+
+			m_polls = 0;
+			m_frequencySums.clear();
+			m_maxTemperature = std::numeric_limits<double>::quiet_NaN();
+			return;
+		}
+	}
+
+	poll();
+	collect(sample);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One round over the data set during a soak run, frequencies are averaged over the round
+struct SoakSample
+{
+	// From the start of the soak run to the end of the round
+	double seconds = 0.0;
+	double roundSeconds = 0.0;
+	double throughputBytesPerSec = 0.0;
+	// Per logical CPU, empty when the frequencies can't be read
+	std::vector<double> coreFrequenciesMHz;
+	// Peak of the hottest thermal zone during the round, NaN when there is none
+	double temperatureCelsius = 0.0;
+	size_t residentSetBytes = 0;
+
+	double meanFrequencyMHz() const;
+};
+
+struct SoakSettings
+{
+	double durationSeconds = 0.0;
+	// Throughput or mean frequency this much below the start counts as throttling
+	double throttleThreshold = 0.1;
+	// Resident set growth after the first round flagged as a likely leak, it must exceed both
+	size_t residentGrowthBytes = size_t(16) << 20;
+	double residentGrowthFraction = 0.05;
+	// Chart and samples are written here when set
+	std::string chartDir;
+};
+
+struct SoakReport
+{
+	// Medians of the rounds at the start, after the first one, and of the last rounds
+	double startThroughput = 0.0;
+	double endThroughput = 0.0;
+	double startFrequencyMHz = 0.0;
+	double endFrequencyMHz = 0.0;
+	double maxTemperatureCelsius = 0.0;
+
+	// First of three consecutive rounds below the threshold, or of the remaining rounds near the end
+	bool throughputThrottled = false;
+	double throughputThrottleSeconds = 0.0;
+	bool frequencyThrottled = false;
+	double frequencyThrottleSeconds = 0.0;
+
+	size_t startResidentSetBytes = 0;
+	size_t endResidentSetBytes = 0;
+	// Least squares slope over all rounds after the first
+	double residentSlopeBytesPerMinute = 0.0;
+	bool residentGrowing = false;
+};
+
+// Parses seconds with an optional s, m or h suffix, e.g. 90, 20m or 1.5h
+bool parseDuration(const std::string& str, double& seconds);
+
+SoakReport analyzeSoak(const std::vector<SoakSample>& samples, const SoakSettings& settings);
+void printSoakReport(std::ostream& out, const std::vector<SoakSample>& samples, const SoakReport& report);
+// Writes <dir>/soak_<name>.csv with every sample and <dir>/soak_<name>.svg with throughput
+// and mean frequency relative to the start over time
+bool writeSoakChart(const std::string& dir, const std::string& name, const std::vector<SoakSample>& samples, const SoakReport& report);
+
+// Polls core frequencies and the hottest thermal zone on a background thread. Frequencies come from
+// cpufreq's scaling_cur_freq on Linux and from CallNtPowerInformation on Windows, where only the
+// frequency is available. The poll thread sleeps between polls and costs next to nothing.
+class SystemMonitor final
+{
+public:
+	SystemMonitor(double intervalSeconds = 1.0);
+	~SystemMonitor();
+
+	SystemMonitor(const SystemMonitor&) = delete;
+	SystemMonitor& operator=(const SystemMonitor&) = delete;
+
+	// Averages of the polls since the previous call, polls once right away if there were none
+	void collect(SoakSample& sample);
+
+private:
+	void poll();
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping = false;
+	size_t m_polls = 0;
+	std::vector<double> m_frequencySums;
+	double m_maxTemperature;
+	std::thread m_thread;
+};
@@ -0,0 +1,38 @@
+#include "statistics.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+double percentile(const std::vector<double>& sortedSamples, double fraction)
+{
+	if (sortedSamples.empty())
+	{
+		return 0.0;
+	}
+
+	auto position = fraction * static_cast<double>(sortedSamples.size() - 1);
+	auto lower = static_cast<size_t>(position);
+	auto upper = std::min(lower + 1, sortedSamples.size() - 1);
+	auto weight = position - static_cast<double>(lower);
+
+	return sortedSamples[lower] + (sortedSamples[upper] - sortedSamples[lower]) * weight;
+}
+
+Statistics computeStatistics(std::vector<double> samples)
+{
+	Statistics result;
+	if (samples.empty())
+	{
+		return result;
+	}
+
+	std::sort(std::begin(samples), std::end(samples));
+
+	result.min = samples.front();
+	result.median = percentile(samples, 0.5);
+	result.mean = std::accumulate(std::begin(samples), std::end(samples), 0.0) / static_cast<double>(samples.size());
+	result.p90 = percentile(samples, 0.9);
+	result.p99 = percentile(samples, 0.99);
+
+	return result;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+struct Statistics
+{
+	double min = 0.0;
+	double median = 0.0;
+	double mean = 0.0;
+	double p90 = 0.0;
+	double p99 = 0.0;
+};
+
+Statistics computeStatistics(std::vector<double> samples);
+
+// Linearly interpolated percentile, samples must be sorted
+double percentile(const std::vector<double>& sortedSamples, double fraction);
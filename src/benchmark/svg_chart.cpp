@@ -0,0 +1,33 @@
+#include "svg_chart.hpp"
+
+#include <iomanip>
+
+void writeSvgChartStart(std::ostream& out, const SvgChart& chart, const std::string& title)
+{
+	auto axisY = chart.height - chart.bottom;
+
+	out << std::fixed << std::setprecision(1);
+	out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << chart.width << "\" height=\"" << chart.height << "\" font-family=\"sans-serif\" font-size=\"11\">" << std::endl;
+	out << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>" << std::endl;
+	out << "<text x=\"" << chart.left << "\" y=\"24\" font-size=\"15\">" << title << "</text>" << std::endl;
+
+	out << "<g stroke=\"black\">" << std::endl;
+	out << "<line x1=\"" << chart.left << "\" y1=\"" << axisY << "\" x2=\"" << chart.width - chart.right << "\" y2=\"" << axisY << "\"/>" << std::endl;
+	out << "<line x1=\"" << chart.left << "\" y1=\"" << chart.top << "\" x2=\"" << chart.left << "\" y2=\"" << axisY << "\"/>" << std::endl;
+	out << "</g>" << std::endl;
+}
+
+void writeSvgChartEnd(std::ostream& out)
+{
+	out << "</svg>" << std::endl;
+}
+
+void addSvgPathPoint(std::string& path, double x, double y)
+{
+	path += (path.empty() ? "M" : " L") + std::to_string(x) + "," + std::to_string(y);
+}
+
+void writeSvgPath(std::ostream& out, const std::string& path, const char* color)
+{
+	out << "<path d=\"" << path << "\" fill=\"none\" stroke=\"" << color << "\" stroke-width=\"1.5\"/>" << std::endl;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+// Size of an SVG chart and the margins around its plot area, which hold the tick labels and legend
+struct SvgChart
+{
+	double width;
+	double height;
+	double left;
+	double right;
+	double top;
+	double bottom;
+
+	double plotWidth() const { return width - left - right; }
+	double plotHeight() const { return height - top - bottom; }
+};
+
+// Opens the document on a white background with the title above the plot area and draws its axes,
+// leaves the stream at fixed precision 1 for the coordinates
+void writeSvgChartStart(std::ostream& out, const SvgChart& chart, const std::string& title);
+void writeSvgChartEnd(std::ostream& out);
+
+// Appends a point to the d attribute of a path, the first one moves there, the others draw a line
+void addSvgPathPoint(std::string& path, double x, double y);
+void writeSvgPath(std::ostream& out, const std::string& path, const char* color);
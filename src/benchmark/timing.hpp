@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+inline uint64_t elapsedNanoseconds(Clock::time_point start, Clock::time_point end)
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// Time stamp counter ticks. On all CPUs we care about the TSC runs at a constant
+// (nominal) rate, so these are reference cycles rather than core clock cycles.
+inline uint64_t readCycleCounter()
+{
+	return __rdtsc();
+}
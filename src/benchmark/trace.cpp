@@ -0,0 +1,176 @@
+#include "trace.hpp"
+#include "json.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent
+{
+	const char* name;
+	std::string detail;
+	uint64_t startNanoseconds;
+	uint64_t durationNanoseconds;
+};
+
+// Only the owning thread appends to its buffer, buffers outlive their threads
+// so that zones of short-lived workers still end up in the trace
+struct TraceThreadBuffer
+{
+	size_t threadId;
+	// Empty for the rows of threads without a TraceThreadName
+	std::string name;
+	std::vector<TraceEvent> events;
+};
+
+namespace
+{
+std::atomic<bool> tracing = false;
+Clock::time_point traceStart;
+
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<TraceThreadBuffer>> buffers;
+std::map<std::string, TraceThreadBuffer*> namedBuffers;
+
+thread_local TraceThreadBuffer* currentBuffer = nullptr;
+
+// Call with buffersMutex held
+TraceThreadBuffer* addBuffer()
+{
+	buffers.push_back(std::make_unique<TraceThreadBuffer>());
+	auto buffer = buffers.back().get();
+	buffer->threadId = buffers.size();
+	return buffer;
+}
+
+TraceThreadBuffer& threadBuffer()
+{
+	if (currentBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		currentBuffer = addBuffer();
+	}
+
+	return *currentBuffer;
+}
+} // namespace
+
+void startTracing()
+{
+	traceStart = Clock::now();
+	tracing.store(true, std::memory_order_release);
+}
+
+bool isTracing()
+{
+	return tracing.load(std::memory_order_relaxed);
+}
+
+TraceThreadName::TraceThreadName(const std::string& name)
+	: m_previous(currentBuffer)
+{
+	if (!isTracing())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	auto& buffer = namedBuffers[name];
+	if (buffer == nullptr)
+	{
+		buffer = addBuffer();
+		buffer->name = name;
+	}
+	currentBuffer = buffer;
+}
+
+TraceThreadName::~TraceThreadName()
+{
+	currentBuffer = m_previous;
+}
+
+bool writeTrace(const std::string& fileName)
+{
+	std::ofstream out(fileName);
+	if (!out)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	// Timestamps are in microseconds, complete events ("X") carry their own duration
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+	out << std::fixed << std::setprecision(3);
+
+	auto first = true;
+	for (const auto& buffer : buffers)
+	{
+		// Metadata event that labels the row of the thread
+		if (!buffer->name.empty())
+		{
+			out << (first ? "" : ",\n");
+			out << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+			writeJsonString(out, buffer->name);
+			out << "}}";
+			first = false;
+		}
+
+		for (const auto& event : buffer->events)
+		{
+			out << (first ? "" : ",\n");
+			out << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"name\":";
+			writeJsonString(out, event.name);
+			out << ",\"ts\":" << event.startNanoseconds * 1e-3 << ",\"dur\":" << event.durationNanoseconds * 1e-3;
+			if (!event.detail.empty())
+			{
+				out << ",\"args\":{\"detail\":";
+				writeJsonString(out, event.detail);
+				out << "}";
+			}
+			out << "}";
+			first = false;
+		}
+	}
+
+	out << std::endl << "]}" << std::endl;
+	return static_cast<bool>(out);
+}
+
+TraceZone::TraceZone(const char* name)
+	: m_name(name)
+	, m_active(isTracing())
+{
+	if (m_active)
+	{
+		threadBuffer();
+		m_start = Clock::now();
+	}
+}
+
+TraceZone::TraceZone(const char* name, const std::string& detail)
+	: m_name(name)
+	, m_active(isTracing())
+{
+	if (m_active)
+	{
+		m_detail = detail;
+		threadBuffer();
+		m_start = Clock::now();
+	}
+}
+
+TraceZone::~TraceZone()
+{
+	if (!m_active)
+	{
+		return;
+	}
+
+	auto end = Clock::now();
+	threadBuffer().events.push_back({ m_name, std::move(m_detail), elapsedNanoseconds(traceStart, m_start), elapsedNanoseconds(m_start, end) });
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "timing.hpp"
+
+#include <string>
+
+// Timeline of scoped zones, exported in the Chrome trace event format that
+// chrome://tracing and Perfetto load. Nothing is recorded until startTracing()
+// is called, a disabled zone costs one relaxed atomic load.
+void startTracing();
+bool isTracing();
+
+// Writes all zones recorded so far, must not race with threads still recording
+bool writeTrace(const std::string& fileName);
+
+struct TraceThreadBuffer;
+
+// Zones of the calling thread go to the row of the given name while this exists, so that threads taking
+// over a role, e.g. the workers of consecutive passes, share one row. One thread at a time per name.
+class TraceThreadName final
+{
+public:
+	TraceThreadName(const std::string& name);
+	~TraceThreadName();
+
+	TraceThreadName(const TraceThreadName&) = delete;
+	TraceThreadName& operator=(const TraceThreadName&) = delete;
+
+private:
+	TraceThreadBuffer* m_previous;
+};
+
+// Records the time between construction and destruction as a zone on the calling thread.
+// name must outlive the trace, detail is shown as an argument of the zone, e.g. the image name.
+// Copying the detail and registering the thread happen on construction and recording the zone
+// on destruction, so a zone opened around a timed region keeps its own cost out of it.
+class TraceZone final
+{
+public:
+	TraceZone(const char* name);
+	TraceZone(const char* name, const std::string& detail);
+	~TraceZone();
+
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+	const char* m_name;
+	std::string m_detail;
+	bool m_active;
+	Clock::time_point m_start;
+};
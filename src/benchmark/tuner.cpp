@@ -0,0 +1,233 @@
+#include "tuner.hpp"
+#include "error_calculator.hpp"
+#include "parallel.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+// Evenly spread over the data set, which is sorted by file name and so mixes sizes and content
+std::vector<size_t> sampleImages(const DataSet& dataSet, size_t sampleCount)
+{
+	std::vector<size_t> indices;
+	auto count = std::min(std::max<size_t>(sampleCount, 1), dataSet.size());
+	for (size_t i = 0; i < count; ++i)
+	{
+		indices.push_back(i * dataSet.size() / count);
+	}
+
+	return indices;
+}
+
+double normalizedRmse(uint64_t squaredErrorSum, uint64_t sampleCount)
+{
+	return sampleCount > 0 ? std::sqrt(static_cast<double>(squaredErrorSum) / sampleCount) / 255.0 : 0.0;
+}
+
+// The best candidate so far bounds the time worth spending, its error bounds nothing
+// because a slower but more accurate candidate is of no use once the target is met
+TuneCandidate evaluateOnSample(
+	const DataSet& dataSet,
+	const std::vector<size_t>& sample,
+	const Configuration& config,
+	const TuneSettings& settings,
+	double bestSeconds)
+{
+	TraceZone zone("tune candidate", describe(config));
+
+	TuneCandidate candidate;
+	candidate.config = config;
+	candidate.status = TuneCandidate::Status::Feasible;
+	candidate.imagesEvaluated = 0;
+	candidate.sampleSeconds = 0.0;
+	candidate.sampleError = 0.0;
+
+	auto channels = relevantChannels(config.format);
+	uint64_t totalSamples = 0;
+	for (auto index : sample)
+	{
+		const auto& image = dataSet[index].image;
+		totalSamples += static_cast<uint64_t>(image.width) * image.height * channels;
+	}
+
+	auto codec = makeCodec(config);
+	CompressedImage compressed;
+
+	// One untimed call so that one-time initialization doesn't count against the candidate
+	if (!codec->compress(dataSet[sample.front()].image, config.format, compressed))
+	{
+		candidate.status = TuneCandidate::Status::Failed;
+		return candidate;
+	}
+
+	uint64_t squaredErrorSum = 0;
+	uint64_t samplesDone = 0;
+	for (auto index : sample)
+	{
+		const auto& image = dataSet[index].image;
+
+		auto start = Clock::now();
+		auto succeeded = codec->compress(image, config.format, compressed);
+		auto end = Clock::now();
+
+		uint64_t imageError = 0;
+		if (!succeeded || !computeBlockErrors(image, compressed, channels, hardwareThreadCount(), imageError))
+		{
+			candidate.status = TuneCandidate::Status::Failed;
+			return candidate;
+		}
+
+		candidate.sampleSeconds += elapsedNanoseconds(start, end) * 1e-9;
+		squaredErrorSum += imageError;
+		samplesDone += static_cast<uint64_t>(image.width) * image.height * channels;
+		++candidate.imagesEvaluated;
+		candidate.sampleError = normalizedRmse(squaredErrorSum, samplesDone);
+
+		// The pooled error of the whole sample can only be at least this, whatever the remaining images do
+		if (normalizedRmse(squaredErrorSum, totalSamples) > settings.maxError)
+		{
+			candidate.status = TuneCandidate::Status::TooInaccurate;
+			return candidate;
+		}
+
+		if (candidate.sampleSeconds > bestSeconds)
+		{
+			candidate.status = TuneCandidate::Status::TooSlow;
+			return candidate;
+		}
+	}
+
+	if (candidate.sampleError > settings.maxError)
+	{
+		candidate.status = TuneCandidate::Status::TooInaccurate;
+	}
+
+	return candidate;
+}
+
+const char* toString(TuneCandidate::Status status)
+{
+	switch (status)
+	{
+	case TuneCandidate::Status::Feasible: return "meets target";
+	case TuneCandidate::Status::TooInaccurate: return "error above target";
+	case TuneCandidate::Status::TooSlow: return "slower than best";
+	case TuneCandidate::Status::TooInaccurateOnDataSet: return "error above target on the data set";
+	case TuneCandidate::Status::Failed: return "failed";
+	default: return "unknown";
+	}
+}
+} // namespace
+
+TuneResult tune(
+	const DataSet& dataSet,
+	const std::vector<Configuration>& candidates,
+	const TuneSettings& settings,
+	const Benchmark::Settings& benchmarkSettings)
+{
+	TuneResult result;
+	if (dataSet.empty() || candidates.empty())
+	{
+		return result;
+	}
+
+	auto sample = sampleImages(dataSet, settings.sampleCount);
+
+	// Lower qualities tend to be faster, trying them first makes the time bound tight early
+	auto ordered = candidates;
+	std::stable_sort(std::begin(ordered), std::end(ordered), [](const Configuration& lhs, const Configuration& rhs)
+	{
+		return static_cast<int>(lhs.quality) < static_cast<int>(rhs.quality);
+	});
+
+	auto bestSeconds = std::numeric_limits<double>::max();
+	for (const auto& config : ordered)
+	{
+		auto candidate = evaluateOnSample(dataSet, sample, config, settings, bestSeconds);
+		if (candidate.status == TuneCandidate::Status::Feasible)
+		{
+			bestSeconds = std::min(bestSeconds, candidate.sampleSeconds);
+		}
+		result.candidates.push_back(candidate);
+	}
+
+	for (;;)
+	{
+		// Meeting the target on the sample doesn't guarantee it on the whole data set
+		TuneCandidate* fastest = nullptr;
+		for (auto& candidate : result.candidates)
+		{
+			if (candidate.status == TuneCandidate::Status::Feasible && (fastest == nullptr || candidate.sampleSeconds < fastest->sampleSeconds))
+			{
+				fastest = &candidate;
+			}
+		}
+
+		if (fastest == nullptr)
+		{
+			break;
+		}
+
+		auto codec = makeCodec(fastest->config);
+		Benchmark benchmark(*codec, benchmarkSettings);
+		auto results = benchmark.run(dataSet, fastest->config.format);
+		if (!results.hasErrors && results.compressionError <= settings.maxError)
+		{
+			result.found = true;
+			result.best = { fastest->config, std::move(results) };
+			break;
+		}
+
+		fastest->status = results.hasErrors ? TuneCandidate::Status::Failed : TuneCandidate::Status::TooInaccurateOnDataSet;
+
+		// Its time may have stopped candidates that beat every one left, so those run again under the new bound
+		bestSeconds = std::numeric_limits<double>::max();
+		for (const auto& candidate : result.candidates)
+		{
+			if (candidate.status == TuneCandidate::Status::Feasible)
+			{
+				bestSeconds = std::min(bestSeconds, candidate.sampleSeconds);
+			}
+		}
+
+		for (auto& candidate : result.candidates)
+		{
+			if (candidate.status == TuneCandidate::Status::TooSlow && candidate.sampleSeconds < bestSeconds)
+			{
+				candidate = evaluateOnSample(dataSet, sample, candidate.config, settings, bestSeconds);
+				if (candidate.status == TuneCandidate::Status::Feasible)
+				{
+					bestSeconds = std::min(bestSeconds, candidate.sampleSeconds);
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+void printTuneResult(std::ostream& out, const TuneResult& result, const TuneSettings& settings)
+{
+	for (const auto& candidate : result.candidates)
+	{
+		out << describe(candidate.config) << "\t\t";
+		out << "Sample time " << std::fixed << std::setprecision(4) << candidate.sampleSeconds << " sec\t\t";
+		out << "Error " << std::setprecision(5) << candidate.sampleError << "\t\t";
+		out << "Images " << candidate.imagesEvaluated << "\t\t" << toString(candidate.status) << std::endl;
+	}
+
+	if (!result.found)
+	{
+		out << "No configuration meets the error target " << std::setprecision(5) << settings.maxError << std::endl;
+		return;
+	}
+
+	out << "Best: " << describe(result.best.config) << std::endl;
+	printResults(out, result.best.results, false);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "benchmark.hpp"
+#include "configuration.hpp"
+#include "report.hpp"
+
+#include <ostream>
+#include <vector>
+
+struct TuneSettings
+{
+	// Largest acceptable RMSE, normalized to [0, 1] like Results::compressionError
+	double maxError = 0.0;
+	// Images evenly spread over the data set that every candidate is first tried on
+	size_t sampleCount = 4;
+};
+
+struct TuneCandidate
+{
+	enum class Status
+	{
+		Feasible,
+		// Stopped once the error of the images done so far guaranteed missing the target
+		TooInaccurate,
+		// Stopped once it took longer than the best feasible candidate on the whole sample
+		TooSlow,
+		// Met the target on the sample but not on the whole data set
+		TooInaccurateOnDataSet,
+		Failed,
+	};
+
+	Configuration config;
+	Status status;
+	size_t imagesEvaluated;
+	double sampleSeconds;
+	double sampleError;
+};
+
+struct TuneResult
+{
+	std::vector<TuneCandidate> candidates;
+	bool found = false;
+	// Full benchmark of the winner on the whole data set
+	ConfigurationResults best;
+};
+
+// Searches candidates of one format for the highest throughput that meets settings.maxError.
+// Every candidate compresses the sample images once, with early termination, then the feasible
+// ones are benchmarked on the whole data set fastest first until one meets the target there too.
+// A candidate failing there no longer bounds the others, those it stopped are tried again.
+TuneResult tune(
+	const DataSet& dataSet,
+	const std::vector<Configuration>& candidates,
+	const TuneSettings& settings,
+	const Benchmark::Settings& benchmarkSettings);
+
+void printTuneResult(std::ostream& out, const TuneResult& result, const TuneSettings& settings);
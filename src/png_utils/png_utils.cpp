@@ -80,6 +80,56 @@ Readback readPng(const char fileName[])
 	return readback;
 }
 
+bool readPngSize(const char fileName[], size_t& width, size_t& height)
+{
+	auto* file = fopen(fileName, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	unsigned char header[8];
+	if (fread(header, 1, 8, file) != 8 || !png_check_sig(header, 8))
+	{
+		fclose(file);
+		return false;
+	}
+
+	auto* png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	if (png == nullptr)
+	{
+		fclose(file);
+		return false;
+	}
+
+	auto* info = png_create_info_struct(png);
+	if (info == nullptr)
+	{
+		png_destroy_read_struct(&png, nullptr, nullptr);
+		fclose(file);
+		return false;
+	}
+
+	if (setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_read_struct(&png, &info, nullptr);
+		fclose(file);
+		return false;
+	}
+
+	png_init_io(png, file);
+	png_set_sig_bytes(png, 8);
+
+	png_read_info(png, info);
+
+	width = png_get_image_width(png, info);
+	height = png_get_image_height(png, info);
+
+	png_destroy_read_struct(&png, &info, nullptr);
+	fclose(file);
+	return true;
+}
+
 bool writePng(const char fileName[], Format format, size_t width, size_t height, unsigned char* data)
 {
 	auto* file = fopen(fileName, "wb");
@@ -13,5 +13,7 @@ struct Readback
 };
 
 Readback readPng(const char fileName[]);
+// Reads only the image header, which is cheap compared to decoding the whole file
+bool readPngSize(const char fileName[], size_t& width, size_t& height);
 bool writePng(const char fileName[], Format format, size_t width, size_t height, unsigned char* data);
 } // namespace PngUtils